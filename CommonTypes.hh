@@ -43,10 +43,29 @@ enum VC_state_type {IDLE_, VC_AB_, ACTIVE_, NUM_VC_STATE_TYPE_};
 enum VNET_type {CTRL_VNET_, DATA_VNET_, NULL_VNET_, NUM_VNET_TYPE_};
 enum flit_stage {I_, VA_, SA_, ST_, LT_, NUM_FLIT_STAGE_};
 enum link_type { EXT_IN_, EXT_OUT_, INT_, NUM_LINK_TYPES_ };
+// HEAP_BUFFER_: flits leave in flit::greater order (time, then id)
+// RING_BUFFER_: flits leave in insertion order, which must be time order
+enum flitBuffer_type { HEAP_BUFFER_, RING_BUFFER_, NUM_FLITBUFFER_TYPE_ };
 enum RoutingAlgorithm { TABLE_ = 0, XY_ = 1, TURN_MODEL_ = 2, RANDOM_ = 3,
                         CUSTOM_ = 4, DEFLECTION_ = 5, TDM_ = 6,
                         NUM_ROUTING_ALGORITHM_};
 
+// How SA ranks flits competing for outports under deflection routing
+// PERMUTATION_NETWORK_ models CHIPPER's two stages of 2x2 arbiter blocks
+enum DeflectionPolicy { CHIPPER_ = 0, BLESS_ = 1, PERMUTATION_NETWORK_ = 2,
+                        NUM_DEFLECTION_POLICY_ };
+
+// inputs and outputs of the CHIPPER permutation network
+#define PERMUTATION_SLOTS_ 4
+
+// When a deflection-routed flit turns gold (GarnetNetwork::isGoldDue)
+// GOLD_DISTANCE_: after as many hops as the shortest path to its destination
+// GOLD_AGE_: after gold_age_threshold cycles since it was created
+// GOLD_EPOCH_: while its (source NI, packet id) is the golden one of the
+//              current epoch; one pair per epoch, rotating (CHIPPER)
+enum GoldPolicy { GOLD_DISTANCE_ = 0, GOLD_AGE_ = 1, GOLD_EPOCH_ = 2,
+                  NUM_GOLD_POLICY_ };
+
 struct RouteInfo
 {
     // destination format for table-based routing
@@ -61,7 +80,20 @@ struct RouteInfo
     int hops_traversed;
 };
 
+// Port directions are interned to small ids when the topology is built
+// (GarnetNetwork::getDirectionId), so the per-flit path compares ints.
+// Mesh directions have fixed ids, any other name gets the next free id.
+enum PortDirectionId { LOCAL_DIRN_ = 0, NORTH_DIRN_ = 1, SOUTH_DIRN_ = 2,
+                       EAST_DIRN_ = 3, WEST_DIRN_ = 4, NUM_MESH_DIRN_ };
+
 #define INFINITE_ 10000
-#define FLIT_ID_ 10000000
+
+// packet latency quantiles reported by GarnetNetwork: p50 p95 p99 p99.9
+#define NUM_LATENCY_QUANTILES_ 4
+
+// TDM schedules are compiled into 64-bit masks:
+// one bit per wave for every outport, one bit per outport for every wave
+#define MAX_WAVES_ 64
+#define MAX_MASK_PORTS_ 64
 
 #endif //__MEM_RUBY_NETWORK_GARNET2_0_COMMONTYPES_HH__
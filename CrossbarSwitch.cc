@@ -61,7 +61,7 @@ CrossbarSwitch::init()
     m_num_inports = m_router->get_num_inports();
     m_switch_buffer.resize(m_num_inports);
     for (int i = 0; i < m_num_inports; i++) {
-        m_switch_buffer[i] = new flitBuffer();
+        m_switch_buffer[i] = new flitBuffer(RING_BUFFER_);
     }
 }
 
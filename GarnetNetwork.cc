@@ -33,9 +33,12 @@
 
 #include "mem/ruby/network/garnet2.0/GarnetNetwork.hh"
 
+#include <algorithm>
 #include <cassert>
 
+#include "base/bitfield.hh"
 #include "base/cast.hh"
+#include "base/output.hh"
 #include "base/stl_helpers.hh"
 #include "mem/ruby/common/NetDest.hh"
 #include "mem/ruby/network/MessageBuffer.hh"
@@ -45,12 +48,18 @@
 #include "mem/ruby/network/garnet2.0/NetworkInterface.hh"
 #include "mem/ruby/network/garnet2.0/NetworkLink.hh"
 #include "mem/ruby/network/garnet2.0/Router.hh"
+#include "mem/ruby/network/garnet2.0/RoutingUnit.hh"
 #include "mem/ruby/system/RubySystem.hh"
 #include "sim/sim_exit.hh"
 
 using namespace std;
 using m5::stl_helpers::deletePointers;
 
+static const double latencyQuantiles[NUM_LATENCY_QUANTILES_] =
+    { 0.5, 0.95, 0.99, 0.999 };
+static const char *latencyQuantileNames[NUM_LATENCY_QUANTILES_] =
+    { "p50", "p95", "p99", "p99_9" };
+
 /*
  * GarnetNetwork sets up the routers and links and collects stats.
  * Default parameters (GarnetNetwork.py) can be overwritten from command line
@@ -62,13 +71,32 @@ GarnetNetwork::GarnetNetwork(const Params *p)
 {
     m_num_rows = p->num_rows;
     m_ni_flit_size = p->ni_flit_size;
+    fatal_if(m_ni_flit_size == 0, "%s: ni_flit_size must be non-zero",
+             name());
     m_vcs_per_vnet = p->vcs_per_vnet;
     m_buffers_per_data_vc = p->buffers_per_data_vc;
     m_buffers_per_ctrl_vc = p->buffers_per_ctrl_vc;
     //cout<<"GN.cc buffer per dvc is "<<m_buffers_per_data_vc << "ctrl vc is "<<m_buffers_per_ctrl_vc<<endl;
     m_routing_algorithm = p->routing_algorithm;
+    m_deflection_policy = p->deflection_policy;
+    fatal_if(m_deflection_policy < 0 ||
+             m_deflection_policy >= NUM_DEFLECTION_POLICY_,
+             "Unknown deflection policy %d\n", m_deflection_policy);
+    m_packet_truncation = p->packet_truncation;
+    m_side_buffer_depth = p->side_buffer_depth;
+    m_gold_policy = p->gold_policy;
+    fatal_if(m_gold_policy < 0 || m_gold_policy >= NUM_GOLD_POLICY_,
+             "Unknown gold policy %d\n", m_gold_policy);
+    m_gold_age_threshold = p->gold_age_threshold;
+    m_gold_epoch_length = p->gold_epoch_length;
+    m_gold_epoch_ids = p->gold_epoch_ids;
+    fatal_if(m_gold_epoch_ids == 0, "gold_epoch_ids must be positive\n");
+    m_gold_epoch = 0;
+    m_diameter = 0;
     warmup_cycles = p->warmup_cycles;//New Added
-    marked_flits = 0;//p->marked_flits;
+    fatal_if(p->marked_flits < 0, "marked_flits must not be negative\n");
+    marked_flits = p->marked_flits;
+    m_marked_flits_per_router = p->marked_flits_per_router;
     marked_flt_injected = 0;
     marked_flt_received = 0;
     total_marked_flit_latency = 0;
@@ -79,8 +107,20 @@ GarnetNetwork::GarnetNetwork(const Params *p)
     marked_flit_latency = Cycles(0);
     marked_flit_network_latency = Cycles(0);
     marked_flit_queueing_latency = Cycles(0);
-    sim_type = 1;//p->sim_type;
+    sim_type = p->sim_type;
+    fatal_if(sim_type != 1 && sim_type != 2,
+             "Unknown sim_type %d, 1: normal, 2: marked flits\n", sim_type);
     cout << "sim-type: " << sim_type << endl;
+    m_saturation_check_interval = Cycles(p->saturation_check_interval);
+    fatal_if(m_saturation_check_interval == 0,
+             "saturation_check_interval must be positive\n");
+    m_next_saturation_check = Cycles(0);
+    m_pair_latency_quantiles = p->pair_latency_quantiles;
+    m_marked_flit_log = nullptr;
+    if (!p->marked_flit_log.empty()) {
+        m_marked_flit_log = simout.create(p->marked_flit_log);
+        *m_marked_flit_log->stream() << "cycle,event,vnet,count\n";
+    }
     //Added end
     m_enable_fault_model = p->enable_fault_model;
     if (m_enable_fault_model)
@@ -88,6 +128,12 @@ GarnetNetwork::GarnetNetwork(const Params *p)
 
     m_vnet_type.resize(m_virtual_networks);
 
+    // mesh directions keep their fixed PortDirectionId
+    m_dirn_names = { "Local", "North", "South", "East", "West" };
+    assert(m_dirn_names.size() == NUM_MESH_DIRN_);
+    for (int i = 0; i < m_dirn_names.size(); i++)
+        m_dirn_ids[m_dirn_names[i]] = i;
+
     for (int i = 0 ; i < m_virtual_networks ; i++) {
         if (m_vnet_type_names[i] == "response")
             m_vnet_type[i] = DATA_VNET_; // carries data (and ctrl) packets
@@ -165,6 +211,7 @@ GarnetNetwork::GarnetNetwork(const Params *p)
         m_nis.push_back(ni);
         ni->init_net_ptr(this);
     }
+    m_router_adj.resize(m_routers.size());
 }
 
 void
@@ -181,6 +228,34 @@ GarnetNetwork::init()
     assert(m_topology_ptr != NULL);
     m_topology_ptr->createLinks(this);
 
+    // all routing tables are complete now
+    for (int i = 0; i < m_routers.size(); i++) {
+        m_routers[i]->get_rtUnit_ptr()->buildRoutingCache();
+    }
+    // wormhole topologies need not be connected through internal links
+    if (usesGoldFlits()) {
+        computeHopDistances();
+        if (m_gold_age_threshold == 0)
+            m_gold_age_threshold = 4 * m_diameter;
+        if (m_gold_epoch_length == 0)
+            m_gold_epoch_length = std::max(4 * m_diameter, 1);
+    }
+
+    // marked flit budgets: the NIs of a router mark the flits they
+    // inject after warmup until its budget is used up
+    if (sim_type == 2) {
+        int num_routers = m_routers.size();
+        for (int i = 0; i < num_routers; i++) {
+            if (m_marked_flits_per_router > 0)
+                m_routers[i]->mrkd_flt_ = m_marked_flits_per_router;
+            else
+                m_routers[i]->mrkd_flt_ = marked_flits / num_routers +
+                    ((uint64_t)i < marked_flits % num_routers ? 1 : 0);
+        }
+        fatal_if(check_mrkd_flt(), "sim_type 2 needs marked_flits or "
+                 "marked_flits_per_router\n");
+    }
+
     // Initialize topology specific parameters
     if (getNumRows() > 0) {
         // Only for Mesh topology
@@ -218,6 +293,21 @@ GarnetNetwork::~GarnetNetwork()
     deletePointers(m_nis);
     deletePointers(m_networklinks);
     deletePointers(m_creditlinks);
+    if (m_marked_flit_log)
+        simout.close(m_marked_flit_log);
+}
+
+int
+GarnetNetwork::getDirectionId(PortDirection dirn)
+{
+    auto it = m_dirn_ids.find(dirn);
+    if (it != m_dirn_ids.end())
+        return it->second;
+
+    int dirn_id = m_dirn_names.size();
+    m_dirn_ids[dirn] = dirn_id;
+    m_dirn_names.push_back(dirn);
+    return dirn_id;
 }
 
 /*
@@ -309,6 +399,68 @@ GarnetNetwork::makeInternalLink(SwitchID src, SwitchID dest, BasicLink* link,
     m_routers[src]->addOutPort(src_outport_dirn, net_link,
                                routing_table_entry,
                                link->m_weight, credit_link, link->m_wave); // modify here, add m_wave parameter
+    m_router_adj[src].push_back(dest);
+}
+
+// Breadth first search from every router over the internal links
+void
+GarnetNetwork::computeHopDistances()
+{
+    int num_routers = m_routers.size();
+    m_router_dist.assign(num_routers * num_routers, -1);
+    m_diameter = 0;
+
+    std::vector<int> queue(num_routers);
+    for (int src = 0; src < num_routers; src++) {
+        int *dist = &m_router_dist[src * num_routers];
+        int head = 0, tail = 0;
+        dist[src] = 0;
+        queue[tail++] = src;
+        while (head < tail) {
+            int router = queue[head++];
+            for (int next : m_router_adj[router]) {
+                if (dist[next] == -1) {
+                    dist[next] = dist[router] + 1;
+                    queue[tail++] = next;
+                }
+            }
+        }
+        for (int dest = 0; dest < num_routers; dest++) {
+            fatal_if(dist[dest] == -1,
+                     "Router %d cannot reach router %d\n", src, dest);
+            m_diameter = std::max(m_diameter, dist[dest]);
+        }
+    }
+}
+
+int
+GarnetNetwork::getGoldThreshold(const RouteInfo &route)
+{
+    if (!usesGoldFlits())
+        return INFINITE_;
+    if (m_gold_policy == GOLD_AGE_)
+        return m_gold_age_threshold;
+    return getHopDistance(route.src_router, route.dest_router);
+}
+
+// Called when a flit arrives at a router
+bool
+GarnetNetwork::isGoldDue(flit *t_flit, Cycles curTime) const
+{
+    if (m_gold_policy == GOLD_AGE_)
+        return (curTime - t_flit->get_enqueue_time() >=
+                Cycles(t_flit->get_gold_th()));
+
+    if (m_gold_policy == GOLD_EPOCH_) {
+        // epoch e: source NI e % N, packet id (e / N) % K
+        uint64_t epoch = getGoldEpoch(curTime);
+        uint64_t num_nis = m_nis.size();
+        return ((uint64_t)t_flit->get_src_ni() == epoch % num_nis &&
+                t_flit->get_packet_seq() % m_gold_epoch_ids ==
+                (epoch / num_nis) % m_gold_epoch_ids);
+    }
+
+    return (t_flit->get_hop_count() >= t_flit->get_gold_th());
 }
 //New Added
 bool
@@ -332,6 +484,30 @@ GarnetNetwork::check_mrkd_flt()
         }
     }
 }
+
+// One CSV row per marked flit event. The stream is left to buffer the
+// rows, it is flushed when full and when the log is closed.
+void
+GarnetNetwork::logMarkedFlit(const char *event, int vnet, uint64_t count)
+{
+    *m_marked_flit_log->stream() << curCycle() << "," << event << ","
+                                 << vnet << "," << count << "\n";
+}
+
+void
+GarnetNetwork::checkNetworkSaturation()
+{
+    if (total_marked_flit_received == 0)
+        return;
+    double avg_flt_network_latency =
+        (double)total_marked_flit_latency/(double)total_marked_flit_received;
+    if (m_marked_flit_log) {
+        *m_marked_flit_log->stream() << curCycle() << ",avg_latency,-1,"
+                                     << avg_flt_network_latency << "\n";
+    }
+    if(avg_flt_network_latency > 1000.0)
+        exitSimLoop("avg flit latency exceeded threshold!.");
+}
 //Added End
 // Total routers in the network
 int
@@ -439,6 +615,197 @@ GarnetNetwork::regStats()
         m_packets_injected_per_router.subname(i, csprintf("router-%i", i));
     }
 
+    m_injection_wave_stalls
+        .name(name() + ".injection_wave_stalls")
+        .flags(Stats::nozero)
+        ;
+
+    // links count flits per wave for the first MAX_WAVES_ waves, which
+    // is also the most a TDM schedule can use (checked in Router::init)
+    int num_waves = std::min((int)getWaveNum(), MAX_WAVES_);
+    m_link_wave_flits
+        .init(m_networklinks.size(), num_waves)
+        .name(name() + ".link_wave_flits")
+        .flags(Stats::nozero)
+        ;
+    m_link_wave_blocked
+        .init(m_networklinks.size(), num_waves)
+        .name(name() + ".link_wave_blocked")
+        .flags(Stats::nozero)
+        ;
+    for (int i = 0; i < m_networklinks.size(); i++) {
+        int link_id = m_networklinks[i]->get_id();
+        m_link_wave_flits.subname(i, csprintf("link-%i", link_id));
+        m_link_wave_blocked.subname(i, csprintf("link-%i", link_id));
+    }
+    for (int w = 0; w < num_waves; w++) {
+        m_link_wave_flits.ysubname(w, csprintf("wave-%i", w));
+        m_link_wave_blocked.ysubname(w, csprintf("wave-%i", w));
+    }
+    m_wave_blocked
+        .name(name() + ".wave_blocked")
+        .flags(Stats::nozero)
+        ;
+    m_wave_slots_open
+        .name(name() + ".wave_slots_open")
+        .flags(Stats::nozero)
+        ;
+    m_wave_slots_used
+        .name(name() + ".wave_slots_used")
+        .flags(Stats::nozero)
+        ;
+    m_schedule_efficiency
+        .name(name() + ".schedule_efficiency")
+        .flags(Stats::nozero)
+        ;
+    m_schedule_efficiency = m_wave_slots_used / m_wave_slots_open;
+
+    m_rob_occupancy
+        .init(16)
+        .name(name() + ".rob_occupancy")
+        .flags(Stats::pdf | Stats::total | Stats::nozero | Stats::oneline)
+        ;
+
+    m_reassembly_latency
+        .init(100)
+        .name(name() + ".reassembly_latency")
+        .flags(Stats::pdf | Stats::total | Stats::nozero | Stats::oneline)
+        ;
+
+    m_side_buffer_absorbed
+        .name(name() + ".side_buffer_absorbed")
+        .flags(Stats::nozero)
+        ;
+
+    m_side_buffer_reinjected
+        .name(name() + ".side_buffer_reinjected")
+        .flags(Stats::nozero)
+        ;
+
+    m_side_buffer_reinject_deflected
+        .name(name() + ".side_buffer_reinject_deflected")
+        .flags(Stats::nozero)
+        ;
+
+    m_side_buffer_deflections_avoided
+        .name(name() + ".side_buffer_deflections_avoided");
+    m_side_buffer_deflections_avoided =
+        m_side_buffer_absorbed - m_side_buffer_reinject_deflected;
+
+    m_side_buffer_occupancy
+        .init(m_side_buffer_depth + 1)
+        .name(name() + ".side_buffer_occupancy")
+        .flags(Stats::pdf | Stats::total | Stats::nozero | Stats::oneline)
+        ;
+
+    m_permutation_flits
+        .name(name() + ".permutation_network_flits")
+        .flags(Stats::nozero)
+        ;
+
+    m_permutation_deflections
+        .init(2)
+        .name(name() + ".permutation_network_deflections")
+        .flags(Stats::pdf | Stats::total | Stats::nozero | Stats::oneline)
+        ;
+    m_permutation_deflections.subname(0, "stage1");
+    m_permutation_deflections.subname(1, "stage2");
+
+    m_golden_epochs
+        .name(name() + ".golden_epochs")
+        .flags(Stats::nozero)
+        ;
+
+    m_golden_flits_received
+        .name(name() + ".golden_flits_received")
+        .flags(Stats::nozero)
+        ;
+
+    m_golden_delivery_hist
+        .init(100)
+        .name(name() + ".golden_delivery_time")
+        .flags(Stats::pdf | Stats::total | Stats::nozero | Stats::oneline)
+        ;
+
+    int num_routers = m_routers.size();
+    m_vnet_latency_sketch.resize(m_virtual_networks);
+    m_pair_flows.assign(num_routers * num_routers, PairFlowStats());
+
+    m_packet_latency_quantile
+        .init(NUM_LATENCY_QUANTILES_)
+        .name(name() + ".packet_latency_quantile")
+        .flags(Stats::nozero | Stats::oneline)
+        ;
+    m_vnet_packet_latency_quantile
+        .init(m_virtual_networks, NUM_LATENCY_QUANTILES_)
+        .name(name() + ".vnet_packet_latency_quantile")
+        .flags(Stats::nozero)
+        ;
+    for (int q = 0; q < NUM_LATENCY_QUANTILES_; q++) {
+        m_packet_latency_quantile.subname(q, latencyQuantileNames[q]);
+        m_vnet_packet_latency_quantile.ysubname(q, latencyQuantileNames[q]);
+    }
+    for (int i = 0; i < m_virtual_networks; i++)
+        m_vnet_packet_latency_quantile.subname(i, csprintf("vnet-%i", i));
+
+    m_pair_packets
+        .init(num_routers, num_routers)
+        .name(name() + ".pair_packets_received")
+        .flags(Stats::nozero)
+        ;
+    m_pair_latency
+        .init(num_routers, num_routers)
+        .name(name() + ".pair_packet_latency")
+        .flags(Stats::nozero)
+        ;
+    m_pair_max_latency
+        .init(num_routers, num_routers)
+        .name(name() + ".pair_max_packet_latency")
+        .flags(Stats::nozero)
+        ;
+    m_pair_hops
+        .init(num_routers, num_routers)
+        .name(name() + ".pair_packet_hops")
+        .flags(Stats::nozero)
+        ;
+    for (int src = 0; src < num_routers; src++) {
+        m_pair_packets.subname(src, csprintf("router-%i", src));
+        m_pair_latency.subname(src, csprintf("router-%i", src));
+        m_pair_max_latency.subname(src, csprintf("router-%i", src));
+        m_pair_hops.subname(src, csprintf("router-%i", src));
+    }
+    for (int dest = 0; dest < num_routers; dest++) {
+        m_pair_packets.ysubname(dest, csprintf("router-%i", dest));
+        m_pair_latency.ysubname(dest, csprintf("router-%i", dest));
+        m_pair_max_latency.ysubname(dest, csprintf("router-%i", dest));
+        m_pair_hops.ysubname(dest, csprintf("router-%i", dest));
+    }
+
+    // routers^2 x quantiles stats, only named (and dumped) on request;
+    // Stats::check() still needs the unnamed stat initialised
+    m_pair_packet_latency_quantile
+        .init(m_pair_latency_quantiles ? num_routers * num_routers : 1,
+              NUM_LATENCY_QUANTILES_)
+        ;
+    if (m_pair_latency_quantiles) {
+        m_pair_latency_sketch.resize(num_routers * num_routers);
+        m_pair_packet_latency_quantile
+            .name(name() + ".pair_packet_latency_quantile")
+            .flags(Stats::nozero)
+            ;
+        for (int q = 0; q < NUM_LATENCY_QUANTILES_; q++) {
+            m_pair_packet_latency_quantile.ysubname(q,
+                latencyQuantileNames[q]);
+        }
+        for (int src = 0; src < num_routers; src++) {
+            for (int dest = 0; dest < num_routers; dest++) {
+                m_pair_packet_latency_quantile.subname(
+                    src * num_routers + dest,
+                    csprintf("router-%i-%i", src, dest));
+            }
+        }
+    }
+
         //new added end
     m_packet_network_latency
         .init(m_virtual_networks)
@@ -657,6 +1024,16 @@ GarnetNetwork::collateStats()
     RubySystem *rs = params()->ruby_system;
     double time_delta = double(curCycle() - rs->getStartCycle());
 
+    // epochs rotate with time, count the ones started in this window
+    if (usesGoldFlits() && m_gold_policy == GOLD_EPOCH_)
+        m_golden_epochs = getGoldEpoch(curCycle()) - m_gold_epoch + 1;
+
+    // each TDM wave comes round once every num_waves cycles
+    int num_waves = getWaveNum();
+    double slots_per_wave = time_delta / num_waves;
+    double wave_slots_open = 0;
+    uint64_t wave_slots_used = 0;
+
     for (int i = 0; i < m_networklinks.size(); i++) {
         link_type type = m_networklinks[i]->getType();
         int activity = m_networklinks[i]->getLinkUtilization();
@@ -675,12 +1052,75 @@ GarnetNetwork::collateStats()
         for (int j = 0; j < vc_load.size(); j++) {
             m_average_vc_load[j] += ((double)vc_load[j] / time_delta);
         }
+
+        uint64_t open_waves = m_networklinks[i]->getOpenWaves();
+        const vector<unsigned int> &wave_flits =
+            m_networklinks[i]->getWaveFlits();
+        const vector<unsigned int> &wave_blocked =
+            m_networklinks[i]->getWaveBlocked();
+        for (int w = 0; w < std::min(num_waves, MAX_WAVES_); w++) {
+            m_link_wave_flits[i][w] = wave_flits[w];
+            m_link_wave_blocked[i][w] = wave_blocked[w];
+            if ((open_waves >> w) & 1)
+                wave_slots_used += wave_flits[w];
+        }
+        wave_slots_open += popCount(open_waves) * slots_per_wave;
     }
+    m_wave_slots_open = wave_slots_open;
+    m_wave_slots_used = wave_slots_used;
 
     // Ask the routers to collate their statistics
     for (int i = 0; i < m_routers.size(); i++) {
         m_routers[i]->collateStats();
     }
+
+    // latency quantiles; the network-wide estimate merges the vnets
+    LatencySketch all_vnets;
+    for (int i = 0; i < m_virtual_networks; i++) {
+        const LatencySketch &sketch = m_vnet_latency_sketch[i];
+        all_vnets.merge(sketch);
+        for (int q = 0; q < NUM_LATENCY_QUANTILES_; q++) {
+            m_vnet_packet_latency_quantile[i][q] =
+                sketch.quantile(latencyQuantiles[q]);
+        }
+    }
+    for (int q = 0; q < NUM_LATENCY_QUANTILES_; q++)
+        m_packet_latency_quantile[q] = all_vnets.quantile(latencyQuantiles[q]);
+    for (int pair = 0; pair < m_pair_latency_sketch.size(); pair++) {
+        const LatencySketch &sketch = m_pair_latency_sketch[pair];
+        if (sketch.get_count() == 0)
+            continue;
+        for (int q = 0; q < NUM_LATENCY_QUANTILES_; q++) {
+            m_pair_packet_latency_quantile[pair][q] =
+                sketch.quantile(latencyQuantiles[q]);
+        }
+    }
+
+    int num_routers = m_routers.size();
+    for (int pair = 0; pair < m_pair_flows.size(); pair++) {
+        const PairFlowStats &flow = m_pair_flows[pair];
+        if (flow.packets == 0)
+            continue;
+        int src = pair / num_routers;
+        int dest = pair % num_routers;
+        m_pair_packets[src][dest] = flow.packets;
+        m_pair_latency[src][dest] = flow.total_latency;
+        m_pair_max_latency[src][dest] = flow.max_latency;
+        m_pair_hops[src][dest] = flow.total_hops;
+    }
+}
+
+void
+GarnetNetwork::resetStats()
+{
+    Network::resetStats();
+    for (auto &sketch : m_vnet_latency_sketch)
+        sketch.reset();
+    for (auto &sketch : m_pair_latency_sketch)
+        sketch.reset();
+    m_pair_flows.assign(m_pair_flows.size(), PairFlowStats());
+    if (usesGoldFlits() && m_gold_policy == GOLD_EPOCH_)
+        m_gold_epoch = getGoldEpoch(curCycle());
 }
 
 void
@@ -35,16 +35,22 @@
 #define __MEM_RUBY_NETWORK_GARNET2_0_GARNETNETWORK_HH__
 
 #include <iostream>
+#include <map>
 #include <vector>
 
 #include "mem/ruby/network/Network.hh"
 #include "mem/ruby/network/fault_model/FaultModel.hh"
 #include "mem/ruby/network/garnet2.0/CommonTypes.hh"
+#include "mem/ruby/network/garnet2.0/Credit.hh"
+#include "mem/ruby/network/garnet2.0/LatencySketch.hh"
+#include "mem/ruby/network/garnet2.0/ObjectPool.hh"
+#include "mem/ruby/network/garnet2.0/flit.hh"
 #include "params/GarnetNetwork.hh"
 #include "sim/sim_exit.hh" //New Added
 
 
 class FaultModel;
+class OutputStream;
 class NetworkInterface;
 class Router;
 class NetDest;
@@ -73,6 +79,10 @@ class GarnetNetwork : public Network
     uint32_t getBuffersPerDataVC() { return m_buffers_per_data_vc; }
     uint32_t getBuffersPerCtrlVC() { return m_buffers_per_ctrl_vc; }
     int getRoutingAlgorithm() const { return m_routing_algorithm; }
+    int getDeflectionPolicy() const { return m_deflection_policy; }
+    bool isPacketTruncation() const { return m_packet_truncation; }
+    uint32_t getSideBufferDepth() const { return m_side_buffer_depth; }
+    int getGoldPolicy() const { return m_gold_policy; }
 
     bool isFaultModelEnabled() const { return m_enable_fault_model; }
     FaultModel* fault_model;
@@ -89,6 +99,38 @@ class GarnetNetwork : public Network
     int getNumRouters();
     int get_router_id(int ni);
 
+    // shortest path hop count between two routers, from the internal links
+    int
+    getHopDistance(int src_router, int dest_router)
+    {
+        return m_router_dist[src_router * m_routers.size() + dest_router];
+    }
+    int getDiameter() const { return m_diameter; }
+
+    // Gold flits of deflection routing, see GoldPolicy. Only the
+    // deflecting routings (DEFLECTION_, and TDM_ through CHIPPER) use them.
+    bool
+    usesGoldFlits() const
+    {
+        return (m_routing_algorithm == DEFLECTION_ ||
+                m_routing_algorithm == TDM_);
+    }
+    int getGoldThreshold(const RouteInfo &route);
+    bool isGoldDue(flit *t_flit, Cycles curTime) const;
+    uint64_t getGoldEpoch(Cycles curTime) const
+    { return curTime / m_gold_epoch_length; }
+
+    // flits and credits are recycled through these pools
+    ObjectPool<flit>& getFlitPool() { return m_flit_pool; }
+    ObjectPool<Credit>& getCreditPool() { return m_credit_pool; }
+
+    // Port direction interning, used while the topology is built
+    int getDirectionId(PortDirection dirn);
+    PortDirection getDirectionName(int dirn_id)
+    {
+        return m_dirn_names[dirn_id];
+    }
+
 
     // Methods used by Topology to setup the network
     void makeExtOutLink(SwitchID src, NodeID dest, BasicLink* link,
@@ -107,6 +149,7 @@ class GarnetNetwork : public Network
     // Stats
     void collateStats();
     void regStats();
+    void resetStats();
     void print(std::ostream& out) const;
 
     bool check_mrkd_flt();
@@ -119,6 +162,65 @@ class GarnetNetwork : public Network
     void increment_router_injected_packets(int router_id){
         m_packets_injected_per_router[router_id]++;
     }
+    void increment_injection_wave_stalls() { m_injection_wave_stalls++; }
+    void increment_wave_blocked() { m_wave_blocked++; }
+    // NI reorder buffers
+    void
+    sample_rob_occupancy(int occupancy)
+    {
+        m_rob_occupancy.sample(occupancy);
+    }
+    void
+    sample_reassembly_latency(Cycles latency)
+    {
+        m_reassembly_latency.sample(latency);
+    }
+
+    // MinBD side buffers
+    void increment_side_buffer_absorbed() { m_side_buffer_absorbed++; }
+    void
+    increment_side_buffer_reinjected(bool deflected)
+    {
+        m_side_buffer_reinjected++;
+        if (deflected)
+            m_side_buffer_reinject_deflected++;
+    }
+    void
+    sample_side_buffer_occupancy(int occupancy)
+    {
+        m_side_buffer_occupancy.sample(occupancy);
+    }
+    // permutation network: flits through it, and flits that lost
+    // their wanted output in arbiter block stage 0 or 1
+    void increment_permutation_flits() { m_permutation_flits++; }
+    void
+    increment_permutation_deflections(int stage)
+    {
+        m_permutation_deflections[stage]++;
+    }
+    // cycles from turning gold to reaching the destination NI
+    void
+    update_golden_delivery(Cycles delay)
+    {
+        m_golden_flits_received++;
+        m_golden_delivery_hist.sample(delay);
+    }
+    // a packet was received: latency quantiles and router pair matrix
+    void
+    record_received_packet(Cycles latency, int vnet, const RouteInfo &route)
+    {
+        int pair = route.src_router * m_routers.size() + route.dest_router;
+        m_vnet_latency_sketch[vnet].sample(latency);
+        if (m_pair_latency_quantiles)
+            m_pair_latency_sketch[pair].sample(latency);
+
+        PairFlowStats &flow = m_pair_flows[pair];
+        flow.packets++;
+        flow.total_latency += latency;
+        if (latency > flow.max_latency)
+            flow.max_latency = latency;
+        flow.total_hops += route.hops_traversed;
+    }
     // //New Added
     void increment_injected_packets(int vnet, bool marked) {
       if(marked == true) {
@@ -206,8 +308,8 @@ class GarnetNetwork : public Network
           m_marked_flt_injected[vnet]++;
           m_marked_flt_dist[m_router_id]++;
           marked_flt_injected++;
-          std::cout << "marked flit injected: " << marked_flt_injected \
-            << " at cycle(): " << curCycle() << std::endl;
+          if (m_marked_flit_log)
+              logMarkedFlit("injected", vnet, marked_flt_injected);
       }
 
     }
@@ -221,8 +323,8 @@ class GarnetNetwork : public Network
          marked_flt_received++;
          total_marked_flit_received++;
 
-         std::cout << "marked flit received: " << marked_flt_received \
-           << " at cycle(): " << curCycle() << std::endl;
+         if (m_marked_flit_log)
+             logMarkedFlit("received", vnet, marked_flt_received);
          bool sim_exit;
          sim_exit = check_mrkd_flt();
 
@@ -274,19 +376,18 @@ class GarnetNetwork : public Network
         }
     }
 
+    // called for every flit received after warmup, only evaluated once
+    // every saturation_check_interval cycles
     void
     check_network_saturation()
     {
-        double avg_flt_network_latency;
-        /*cout << "total marked_flit latency (queuing+network): " \
-            << total_marked_flit_latency << std::endl;*/
-        avg_flt_network_latency =
-            (double)total_marked_flit_latency/(double)total_marked_flit_received;
-        cout << "average marked flit latency: " << avg_flt_network_latency << endl;
-        cout.flush();
-        if(avg_flt_network_latency > 1000.0)
-            exitSimLoop("avg flit latency exceeded threshold!.");
+        if (curCycle() < m_next_saturation_check)
+            return;
+        m_next_saturation_check = curCycle() + m_saturation_check_interval;
+        checkNetworkSaturation();
     }
+    void checkNetworkSaturation();
+    void logMarkedFlit(const char *event, int vnet, uint64_t count);
     //Added End
 /*
     void
@@ -326,12 +427,19 @@ class GarnetNetwork : public Network
     uint64_t total_marked_flit_latency;
     uint64_t total_marked_flit_received;
 
+    // CSV marked flit log, nullptr when marked_flit_log is empty
+    OutputStream *m_marked_flit_log;
+    Cycles m_saturation_check_interval;
+    bool m_pair_latency_quantiles;
+    Cycles m_next_saturation_check;
+
     uint64_t marked_flt_injected;
     uint64_t marked_flt_received;
     uint64_t marked_pkt_injected;
     uint64_t marked_pkt_received;
     uint64_t warmup_cycles;
     uint64_t marked_flits;
+    uint32_t m_marked_flits_per_router;
 
     int sim_type;
 
@@ -361,6 +469,39 @@ class GarnetNetwork : public Network
     uint32_t m_buffers_per_data_vc;
     int m_routing_algorithm;
     bool m_enable_fault_model;
+    int m_deflection_policy;
+    bool m_packet_truncation;
+    uint32_t m_side_buffer_depth;
+    int m_gold_policy;
+    uint32_t m_gold_age_threshold;
+    uint32_t m_gold_epoch_length;
+    uint32_t m_gold_epoch_ids;
+    // first golden epoch of the current stats window
+    uint64_t m_gold_epoch;
+
+    // router adjacency from the internal links, and the resulting
+    // all-pairs hop distances [src_router * num_routers + dest_router]
+    std::vector<std::vector<int>> m_router_adj;
+    std::vector<int> m_router_dist;
+    int m_diameter;
+
+    void computeHopDistances();
+
+    // streaming packet latency estimates behind the quantile stats,
+    // per vnet and per router pair (src_router * routers + dest_router)
+    std::vector<LatencySketch> m_vnet_latency_sketch;
+    std::vector<LatencySketch> m_pair_latency_sketch;
+
+    // received packets per router pair, same indexing, copied to the
+    // m_pair_* stats in collateStats
+    struct PairFlowStats
+    {
+        uint64_t packets;
+        uint64_t total_latency;
+        uint64_t max_latency;
+        uint64_t total_hops;
+    };
+    std::vector<PairFlowStats> m_pair_flows;
 
     // Statistical variables
     Stats::Vector m_packets_received;
@@ -433,15 +574,66 @@ class GarnetNetwork : public Network
 
     //New added tdm
     Stats::Vector m_packets_injected_per_router;
+    Stats::Scalar m_injection_wave_stalls;
+
+    // TDM schedule use: per link x wave flits sent and flits that found
+    // the link closed, and the share of open wave slots that carried a
+    // flit
+    Stats::Vector2d m_link_wave_flits;
+    Stats::Vector2d m_link_wave_blocked;
+    Stats::Scalar m_wave_blocked;
+    Stats::Scalar m_wave_slots_open;
+    Stats::Scalar m_wave_slots_used;
+    Stats::Formula m_schedule_efficiency;
+
+    // packets being reassembled at an NI, and cycles from the first
+    // to the last flit of a packet arriving there
+    Stats::Histogram m_rob_occupancy;
+    Stats::Histogram m_reassembly_latency;
+
+    // MinBD side buffers: flits taken instead of being deflected, and
+    // flits sent back out (deflected when drained from a full buffer)
+    Stats::Scalar m_side_buffer_absorbed;
+    Stats::Scalar m_side_buffer_reinjected;
+    Stats::Scalar m_side_buffer_reinject_deflected;
+    Stats::Formula m_side_buffer_deflections_avoided;
+    Stats::Histogram m_side_buffer_occupancy;
+
+    Stats::Scalar m_permutation_flits;
+    Stats::Vector m_permutation_deflections;
+
+    // gold flits of deflection routing
+    Stats::Scalar m_golden_epochs;
+    Stats::Scalar m_golden_flits_received;
+    Stats::Histogram m_golden_delivery_hist;
+
+    // packet latency quantiles (NUM_LATENCY_QUANTILES_ of them), over all
+    // packets, per vnet, and per source x destination router pair (only
+    // with pair_latency_quantiles)
+    Stats::Vector m_packet_latency_quantile;
+    Stats::Vector2d m_vnet_packet_latency_quantile;
+    Stats::Vector2d m_pair_packet_latency_quantile;
+
+    // source x destination router matrix of received packets
+    Stats::Vector2d m_pair_packets;
+    Stats::Vector2d m_pair_latency;
+    Stats::Vector2d m_pair_max_latency;
+    Stats::Vector2d m_pair_hops;
   private:
     GarnetNetwork(const GarnetNetwork& obj);
     GarnetNetwork& operator=(const GarnetNetwork& obj);
 
     std::vector<VNET_type > m_vnet_type;
+    // interned port directions, see PortDirectionId
+    std::map<PortDirection, int> m_dirn_ids;
+    std::vector<PortDirection> m_dirn_names;
     //std::vector<Router *> m_routers;   // All Routers in Network
     std::vector<NetworkLink *> m_networklinks; // All flit links in the network
     std::vector<CreditLink *> m_creditlinks; // All credit links in the network
     std::vector<NetworkInterface *> m_nis;   // All NI's in Network
+
+    ObjectPool<flit> m_flit_pool;
+    ObjectPool<Credit> m_credit_pool;
 };
 
 inline std::ostream&
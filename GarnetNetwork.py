@@ -43,14 +43,45 @@ class GarnetNetwork(RubyNetwork):
     buffers_per_data_vc = Param.UInt32(4, "buffers per data virtual channel");
     buffers_per_ctrl_vc = Param.UInt32(1, "buffers per ctrl virtual channel");
     routing_algorithm = Param.Int(0,
-        "0: Weight-based Table, 1: XY, 2: Custom");
+        "0: Weight-based Table, 1: XY, 2: Turn Model, 3: Random, "
+        "4: Custom, 5: Deflection, 6: TDM (wave number in clock_object.hh "
+        "at most 64, MAX_WAVES_)");
     enable_fault_model = Param.Bool(False, "enable network fault model");
     fault_model = Param.FaultModel(NULL, "network fault model");
     garnet_deadlock_threshold = Param.UInt32(50000,
                               "network-level deadlock threshold")
+    deflection_policy = Param.Int(0,
+        "deflection permutation, 0: CHIPPER, 1: BLESS, "
+        "2: CHIPPER two-stage permutation network");
+    packet_truncation = Param.Bool(True,
+        "deflection/TDM routing: route each flit of a multi-flit packet "
+        "on its own and reassemble it at the destination NI, "
+        "else send every packet whole as a single flit");
+    side_buffer_depth = Param.UInt32(0,
+        "deflection routing: flits in each router's MinBD side buffer, "
+        "0: no side buffer");
+    gold_policy = Param.Int(0,
+        "deflection gold flits, 0: hop distance, 1: age, 2: golden epoch");
+    gold_age_threshold = Param.UInt32(0,
+        "age gold policy: cycles before a flit turns gold, "
+        "0: 4 x network diameter");
+    gold_epoch_length = Param.UInt32(0,
+        "golden epoch policy: cycles per epoch, 0: 4 x network diameter");
+    gold_epoch_ids = Param.UInt32(8,
+        "golden epoch policy: packet ids per source NI that take turns");
+    marked_flit_log = Param.String("",
+        "CSV log of marked flit events in the output directory, "
+        "empty: no log");
+    pair_latency_quantiles = Param.Bool(False,
+        "report latency quantiles per source/destination router pair");
+    saturation_check_interval = Param.UInt32(1000,
+        "sim_type 2: cycles between network saturation checks after warmup");
     sim_type = Param.Int(Parent.sim_type, "simulation_type")
     warmup_cycles = Param.Int(Parent.warmup_cycles, "warmup_cycles")
     marked_flits = Param.Int(Parent.marked_flits, "number of marked flits") 
+    marked_flits_per_router = Param.UInt32(0,
+        "sim_type 2: marked flits injected at each router after warmup, "
+        "0: marked_flits split evenly over the routers");
     #New Added
 class GarnetNetworkInterface(ClockedObject):
     type = 'GarnetNetworkInterface'
@@ -37,6 +37,7 @@
 #include "debug/RubyNetwork.hh"
 #include "mem/ruby/network/garnet2.0/Credit.hh"
 #include "mem/ruby/network/garnet2.0/Router.hh"
+#include "mem/ruby/network/garnet2.0/RoutingUnit.hh"
 
 using namespace std;
 using m5::stl_helpers::deletePointers;
@@ -59,7 +60,7 @@ InputUnit::InputUnit(int id, PortDirection direction, Router *router)
         m_num_buffer_writes[i] = 0;
     }
 
-    creditQueue = new flitBuffer();
+    creditQueue = new flitBuffer(RING_BUFFER_);
     // Instantiating the virtual channels
     m_vcs.resize(m_num_vcs);
     for (int i=0; i < m_num_vcs; i++) {
@@ -95,16 +96,25 @@ InputUnit::wakeup()
         t_flit = m_in_link->consumeLink();
         int vc = t_flit->get_vc();
         t_flit->increment_hops(); // for stats
-        if(!t_flit->is_gold_state()){
-            if(t_flit->get_hop_count() == t_flit->get_gold_th())
-                t_flit->set_gold_state();
+        GarnetNetwork *net_ptr = m_router->get_net_ptr();
+        if(net_ptr->usesGoldFlits()){
+            if(net_ptr->getGoldPolicy() == GOLD_EPOCH_){
+                // gold only during the epoch of its packet
+                if(net_ptr->isGoldDue(t_flit, m_router->curCycle()))
+                    t_flit->set_gold_state(m_router->curCycle());
+                else
+                    t_flit->clear_gold_state();
+            }else if(!t_flit->is_gold_state()){
+                if(net_ptr->isGoldDue(t_flit, m_router->curCycle()))
+                    t_flit->set_gold_state(m_router->curCycle());
+            }
         }
         
         RoutingAlgorithm routing_algo =
             (RoutingAlgorithm) m_router->get_net_ptr()->getRoutingAlgorithm();
         if(routing_algo == DEFLECTION_ || routing_algo == TDM_){
             //route compute for all flits
-            if(m_direction != "Local"){
+            if(!m_router->get_rtUnit_ptr()->is_local_inport(m_id)){
                 assert(m_vcs[vc]->get_state() == IDLE_);
             
                 set_vc_active(vc, m_router->curCycle()); //TODO: does the cycle time affect function?
@@ -180,6 +190,7 @@ InputUnit::wakeup()
             // Wakeup the router in that cycle to perform SA
             m_router->schedule_wakeup(Cycles(wait_time));
         }
+        m_router->sa_flit_inserted(t_flit->get_stage().second);
     }
 }
 
@@ -188,7 +199,8 @@ InputUnit::wakeup()
 void
 InputUnit::increment_credit(int in_vc, bool free_signal, Cycles curTime)
 {
-    Credit *t_credit = new Credit(in_vc, free_signal, curTime);
+    Credit *t_credit = m_router->get_net_ptr()->getCreditPool().allocate(
+        in_vc, free_signal, curTime);
     creditQueue->insert(t_credit);
     m_credit_link->scheduleEventAbsolute(m_router->clockEdge(Cycles(1)));
 }
@@ -109,7 +109,10 @@ class InputUnit : public Consumer
     inline flit*
     getTopFlit(int vc)
     {
-        return m_vcs[vc]->getTopFlit();
+        // buffered flits stay in SA_ until they leave the VC
+        flit *t_flit = m_vcs[vc]->getTopFlit();
+        m_router->sa_flit_removed(t_flit->get_stage().second);
+        return t_flit;
     }
 
     inline bool
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2019 Georgia Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Chen Chen
+ */
+
+
+#include "mem/ruby/network/garnet2.0/LatencySketch.hh"
+
+#include "base/bitfield.hh"
+
+// bucket index: exact below 2^SUB_BITS_, then 2^SUB_BITS_ sub-buckets
+// per power of two, indexed by the bits below the leading one
+int
+LatencySketch::bucketOf(uint64_t value)
+{
+    if (value < (1ULL << SUB_BITS_))
+        return value;
+    int msb = findMsbSet(value);
+    int shift = msb - SUB_BITS_;
+    uint64_t sub = (value >> shift) & ((1ULL << SUB_BITS_) - 1);
+    return ((shift + 1) << SUB_BITS_) + sub;
+}
+
+// largest value that falls in a bucket
+uint64_t
+LatencySketch::bucketMax(int bucket)
+{
+    if (bucket < (1 << SUB_BITS_))
+        return bucket;
+    int shift = (bucket >> SUB_BITS_) - 1;
+    uint64_t sub = bucket & ((1 << SUB_BITS_) - 1);
+    uint64_t low = ((1ULL << SUB_BITS_) | sub) << shift;
+    return low + (1ULL << shift) - 1;
+}
+
+void
+LatencySketch::sample(uint64_t value)
+{
+    int bucket = bucketOf(value);
+    if (bucket >= (int)m_buckets.size())
+        m_buckets.resize(bucket + 1, 0);
+    m_buckets[bucket]++;
+    m_count++;
+}
+
+void
+LatencySketch::merge(const LatencySketch &other)
+{
+    if (other.m_buckets.size() > m_buckets.size())
+        m_buckets.resize(other.m_buckets.size(), 0);
+    for (int i = 0; i < (int)other.m_buckets.size(); i++)
+        m_buckets[i] += other.m_buckets[i];
+    m_count += other.m_count;
+}
+
+void
+LatencySketch::reset()
+{
+    m_buckets.clear();
+    m_count = 0;
+}
+
+uint64_t
+LatencySketch::quantile(double q) const
+{
+    if (m_count == 0)
+        return 0;
+    // rank of the wanted sample, 1-based
+    uint64_t rank = (uint64_t)(q * m_count);
+    if (rank < q * m_count)
+        rank++;
+    if (rank == 0)
+        rank = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < (int)m_buckets.size(); i++) {
+        seen += m_buckets[i];
+        if (seen >= rank)
+            return bucketMax(i);
+    }
+    return bucketMax(m_buckets.size() - 1);
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2019 Georgia Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Chen Chen
+ */
+
+
+#ifndef __MEM_RUBY_NETWORK_GARNET2_0_LATENCYSKETCH_HH__
+#define __MEM_RUBY_NETWORK_GARNET2_0_LATENCYSKETCH_HH__
+
+#include <cstdint>
+#include <vector>
+
+// Streaming quantile estimate of a latency distribution, HDR style:
+// values below 2^SUB_BITS_ are counted exactly, larger values in log
+// buckets split into 2^SUB_BITS_ linear sub-buckets, so a quantile is
+// off by less than 2^-SUB_BITS_ of its value. Sketches of the same
+// kind merge by adding bucket counts.
+
+class LatencySketch
+{
+  public:
+    LatencySketch() : m_count(0) {}
+
+    void sample(uint64_t value);
+    void merge(const LatencySketch &other);
+    void reset();
+
+    uint64_t get_count() const { return m_count; }
+    // smallest value v such that at least a fraction q of the samples
+    // are <= v (up to the bucket resolution); 0 without samples
+    uint64_t quantile(double q) const;
+
+  private:
+    static const int SUB_BITS_ = 5;
+
+    static int bucketOf(uint64_t value);
+    static uint64_t bucketMax(int bucket);
+
+    std::vector<uint64_t> m_buckets;    // grows to the largest bucket
+    uint64_t m_count;
+};
+
+#endif // __MEM_RUBY_NETWORK_GARNET2_0_LATENCYSKETCH_HH__
@@ -52,18 +52,20 @@ NetworkInterface::NetworkInterface(const Params *p)
       m_virtual_networks(p->virt_nets), m_vc_per_vnet(p->vcs_per_vnet),
       m_num_vcs(m_vc_per_vnet * m_virtual_networks),
       m_deadlock_threshold(p->garnet_deadlock_threshold),
-      vc_busy_counter(m_virtual_networks, 0)
+      vc_busy_counter(m_virtual_networks, 0),
+      m_rob(4 * m_num_vcs)
 {
     m_router_id = -1;
     m_vc_round_robin = 0;
+    m_packet_seq = 0;
+    m_last_wave_stall = Cycles(MaxTick);
     m_ni_out_vcs.resize(m_num_vcs);
     m_ni_out_vcs_enqueue_time.resize(m_num_vcs);
-    outCreditQueue = new flitBuffer();
+    outCreditQueue = new flitBuffer(RING_BUFFER_);
 
-    m_rob.clear();
     // instantiating the NI flit buffers
     for (int i = 0; i < m_num_vcs; i++) {
-        m_ni_out_vcs[i] = new flitBuffer();
+        m_ni_out_vcs[i] = new flitBuffer(RING_BUFFER_);
         m_ni_out_vcs_enqueue_time[i] = Cycles(INFINITE_);
     }
 
@@ -110,7 +112,7 @@ NetworkInterface::addOutPort(NetworkLink *out_link,
     credit_link->setLinkConsumer(this);
 
     outNetLink = out_link;
-    outFlitQueue = new flitBuffer();
+    outFlitQueue = new flitBuffer(RING_BUFFER_);
     out_link->setSourceQueue(outFlitQueue);
     m_router_id = router_id;
 }
@@ -198,6 +200,8 @@ NetworkInterface::incrementStats(flit *t_flit)
 
         if (t_flit->get_type() == TAIL_ || t_flit->get_type() == HEAD_TAIL_) {
             m_net_ptr->increment_received_packets(vnet, t_flit->m_marked);
+            m_net_ptr->record_received_packet(total_delay, vnet,
+                                              t_flit->get_route());
             m_net_ptr->increment_packet_network_latency(network_delay, vnet,
                                                         t_flit->m_marked);
             m_net_ptr->increment_packet_queueing_latency(queueing_delay, vnet,
@@ -226,6 +230,8 @@ NetworkInterface::incrementStats(flit *t_flit)
 
         if (t_flit->get_type() == TAIL_ || t_flit->get_type() == HEAD_TAIL_) {
             m_net_ptr->increment_received_packets(vnet, t_flit->m_marked);
+            m_net_ptr->record_received_packet(total_delay, vnet,
+                                              t_flit->get_route());
             m_net_ptr->increment_packet_network_latency(network_delay, vnet,
                                                         t_flit->m_marked);
             m_net_ptr->increment_packet_queueing_latency(queueing_delay, vnet,
@@ -241,7 +247,10 @@ void
 NetworkInterface::incrementStats(flit *t_flit, bool is_arrived)
 {
 	int vnet = t_flit->get_vnet();
-	assert(m_net_ptr->sim_type == 1);
+
+    if (t_flit->was_gold())
+        m_net_ptr->update_golden_delivery(curCycle() -
+                                          t_flit->get_gold_time());
     
     //Latency
     m_net_ptr->increment_received_flits(vnet, t_flit->m_marked);
@@ -259,6 +268,11 @@ NetworkInterface::incrementStats(flit *t_flit, bool is_arrived)
     m_net_ptr->update_flit_network_latency_histogram(network_delay, vnet, t_flit->m_marked);
     m_net_ptr->update_flit_queueing_latency_histogram(queueing_delay, vnet, t_flit->m_marked);
 
+    if (m_net_ptr->sim_type == 2 &&
+        curCycle() > (Cycles)m_net_ptr->warmup_cycles) {
+        m_net_ptr->check_network_saturation();
+    }
+
 	/*
     if (t_flit->get_type() == TAIL_ || t_flit->get_type() == HEAD_TAIL_) {
         m_net_ptr->increment_received_packets(vnet);
@@ -268,6 +282,8 @@ NetworkInterface::incrementStats(flit *t_flit, bool is_arrived)
     */
     if(is_arrived){
     	m_net_ptr->increment_received_packets(vnet, t_flit->m_marked);
+        m_net_ptr->record_received_packet(total_delay, vnet,
+                                          t_flit->get_route());
         m_net_ptr->increment_packet_network_latency(network_delay, vnet,
                                                     t_flit->m_marked);
         m_net_ptr->increment_packet_queueing_latency(queueing_delay, vnet,
@@ -324,7 +340,7 @@ NetworkInterface::wakeup()
         flit *t_flit = inNetLink->consumeLink();
         int vnet = t_flit->get_vnet();
         t_flit->set_dequeue_time(curCycle());
-        //std::cout<<"Ni this flit id is "<<t_flit->getClkId()<<endl;
+        //std::cout<<"Ni this flit id is "<<t_flit->get_packet_id()<<endl;
         
         RoutingAlgorithm routing_algorithm =
         (RoutingAlgorithm) m_net_ptr->getRoutingAlgorithm();
@@ -343,7 +359,7 @@ NetworkInterface::wakeup()
 
                     // Update stats and delete flit pointer
                     incrementStats(t_flit, true);
-                    delete t_flit;
+                    m_net_ptr->getFlitPool().release(t_flit);
                 } else {
                     // No space available- Place tail flit in stall queue and set
                     // up a callback for when protocol buffer is dequeued. Stat
@@ -356,10 +372,6 @@ NetworkInterface::wakeup()
                 }
             }else{
                 if(areAllFlitsHere(t_flit)){
-                    
-                    //erase this message in ROB
-                    m_rob.erase(t_flit->getClkId());
-                    
                     if (!messageEnqueuedThisCycle &&
                         outNode_ptr[vnet]->areNSlotsAvailable(1, curTime)) {
                         // Space is available. Enqueue to protocol buffer.
@@ -372,7 +384,7 @@ NetworkInterface::wakeup()
 
                         // Update stats and delete flit pointer
                         incrementStats(t_flit, true);
-                        delete t_flit;
+                        m_net_ptr->getFlitPool().release(t_flit);
                     } else {
                         // No space available- Place tail flit in stall queue and set
                         // up a callback for when protocol buffer is dequeued. Stat
@@ -390,7 +402,7 @@ NetworkInterface::wakeup()
 
                     // Update stats and delete flit pointer.
                     incrementStats(t_flit, false);
-                    delete t_flit;
+                    m_net_ptr->getFlitPool().release(t_flit);
                 }
             }
             //new added done
@@ -410,7 +422,7 @@ NetworkInterface::wakeup()
 
                     // Update stats and delete flit pointer
                     incrementStats(t_flit);
-                    delete t_flit;
+                    m_net_ptr->getFlitPool().release(t_flit);
                 } else {
                     // No space available- Place tail flit in stall queue and set
                     // up a callback for when protocol buffer is dequeued. Stat
@@ -427,7 +439,7 @@ NetworkInterface::wakeup()
 
                 // Update stats and delete flit pointer.
                 incrementStats(t_flit);
-                delete t_flit;
+                m_net_ptr->getFlitPool().release(t_flit);
             }
         }
     }
@@ -445,7 +457,7 @@ NetworkInterface::wakeup()
         	// 	cout<<"NI : "<<m_id<<" set vc "<<t_credit->get_vc()<<" to IDLE at cycle "<<curCycle()<<endl;
             m_out_vc_state[t_credit->get_vc()]->setState(IDLE_, curCycle());
         }
-        delete t_credit;
+        m_net_ptr->getCreditPool().release(t_credit);
     }
 
 
@@ -463,26 +475,20 @@ NetworkInterface::areAllFlitsHere(flit *t_flit)
 {
     assert(t_flit->get_type() != HEAD_TAIL_);
 
-    int flitId = t_flit->getClkId();
-
-    auto it = m_rob.find(flitId);
-    
-    if(it == m_rob.end()) // new arrived flit
-        m_rob[flitId] = 1;
-    else{                  //already exist flit
-        m_rob[flitId] += 1;
-        assert(m_rob[flitId] <= 5);
-    }
-    if(m_rob[flitId] == 5)
-        return true;//free last arrived flit outside
-    else
-        return false;
+    Cycles first_arrival;
+    bool complete = m_rob.arrive(t_flit->get_packet_id(), t_flit->get_size(),
+                                 curCycle(), first_arrival);
+    m_net_ptr->sample_rob_occupancy(m_rob.get_occupancy());
+    if(complete) //free last arrived flit outside, the entry is erased
+        m_net_ptr->sample_reassembly_latency(curCycle() - first_arrival);
+    return complete;
 }
 
 void
 NetworkInterface::sendCredit(flit *t_flit, bool is_free)
 {
-    Credit *credit_flit = new Credit(t_flit->get_vc(), is_free, curCycle());
+    Credit *credit_flit = m_net_ptr->getCreditPool().allocate(
+        t_flit->get_vc(), is_free, curCycle());
     outCreditQueue->insert(credit_flit);
 }
 
@@ -511,13 +517,13 @@ NetworkInterface::checkStallQueue()
                 sendCredit(stallFlit, true);
 
                 // Update Stats
-                if(routing_algorithm != DEFLECTION_ || routing_algorithm != TDM_)
+                if(routing_algorithm != DEFLECTION_ && routing_algorithm != TDM_)
                 	incrementStats(stallFlit);
                 else
                 	incrementStats(stallFlit, true);
 
                 // Flit can now safely be deleted and removed from stall queue
-                delete stallFlit;
+                m_net_ptr->getFlitPool().release(stallFlit);
                 m_stall_queue.erase(stallIter);
                 m_stall_count[vnet]--;
 
@@ -556,7 +562,15 @@ NetworkInterface::flitisizeMessage(MsgPtr msg_ptr, int vnet)
     //if(m_net_ptr->MessageSizeType_to_int(net_msg_ptr->getMessageSize()) > m_net_ptr->getNiFlitSize()){
         //panic("not enough niflit size, message size %d, ni size %d",m_net_ptr->MessageSizeType_to_int(net_msg_ptr->getMessageSize()), m_net_ptr->getNiFlitSize());
     //}
-    assert(num_flits == 1 || num_flits == 5);
+    // any flit count works: deflection and TDM reassemble multi-flit
+    // packets by packet id and size in the reorder buffer
+    assert(num_flits >= 1);
+    RoutingAlgorithm routing_algo =
+        (RoutingAlgorithm) m_net_ptr->getRoutingAlgorithm();
+    // without truncation a packet travels whole, as one flit
+    if ((routing_algo == DEFLECTION_ || routing_algo == TDM_) &&
+        !m_net_ptr->isPacketTruncation())
+        num_flits = 1;
 
     for (int ctr = 0; ctr < dest_nodes.size(); ctr++) {
         
@@ -584,8 +598,6 @@ NetworkInterface::flitisizeMessage(MsgPtr msg_ptr, int vnet)
         // 	cout<< m_id<<", " <<vc<<", pkg size "<<num_flits<<", at cycle" <<curCycle()<<endl;
         // }
 
-        RoutingAlgorithm routing_algo =
-        (RoutingAlgorithm) m_net_ptr->getRoutingAlgorithm();
         //if vc avaliable, make sure it is the first vc of the vnet
         if(routing_algo == DEFLECTION_ || routing_algo == TDM_)
             assert(vc == vnet);
@@ -628,6 +640,8 @@ NetworkInterface::flitisizeMessage(MsgPtr msg_ptr, int vnet)
         // initialize hops_traversed to -1
         // so that the first router increments it to 0
         route.hops_traversed = -1;
+        int gold_th = m_net_ptr->getGoldThreshold(route);
+        uint32_t packet_seq = m_packet_seq++;
         /*original version
         m_net_ptr->increment_injected_packets(vnet);
         for (int i = 0; i < num_flits; i++) {
@@ -645,18 +659,20 @@ NetworkInterface::flitisizeMessage(MsgPtr msg_ptr, int vnet)
                  if((curCycle() > (Cycles)m_net_ptr->warmup_cycles) &&
                     // (m_net_ptr->marked_flt_injected < m_net_ptr->marked_flits)) {
                     (m_net_ptr->m_routers.at(m_router_id)->mrkd_flt_ > 0)) {
-                        fl = new flit(i, vc, vnet, route, num_flits, new_msg_ptr,
-                                curCycle(), true);
+                        fl = m_net_ptr->getFlitPool().allocate(i, vc, vnet,
+                                route, num_flits, new_msg_ptr, curCycle(), true);
                         m_net_ptr->m_routers.at(m_router_id)->mrkd_flt_--;
                  } else {
-                        fl = new flit(i, vc, vnet, route, num_flits, new_msg_ptr,
-                                      curCycle());
+                        fl = m_net_ptr->getFlitPool().allocate(i, vc, vnet,
+                                      route, num_flits, new_msg_ptr, curCycle());
                  }
             } else {
-                fl = new flit(i, vc, vnet, route, num_flits, new_msg_ptr,
-                             curCycle());
+                fl = m_net_ptr->getFlitPool().allocate(i, vc, vnet,
+                             route, num_flits, new_msg_ptr, curCycle());
                 assert(vc == vnet);
             }
+            fl->set_gold_th(gold_th);
+            fl->set_packet_seq(packet_seq);
             m_net_ptr->increment_injected_flits(vnet, fl->m_marked, m_router_id);
             fl->set_src_delay(curCycle() - ticksToCycles(msg_ptr->getTime()));
             m_ni_out_vcs[vc]->insert(fl);
@@ -719,16 +735,17 @@ NetworkInterface::scheduleOutputLink()
 {
     int vc = m_vc_round_robin;
     //m_vc_round_robin++; TODO
-/*    
-    Cycles cur_Wave = curWave();
-    Cycles next2_Wave = cur_Wave + Cycles(2); // flit spend one wave time traverse through its own router
-    Cycles index_Wave = Cycles(0); // wave stored on wave_table
-    //TODO how to get rout information??
-*/    
     // if (m_vc_round_robin == m_num_vcs)
     //     m_vc_round_robin = 0;
-    
-//unnecessary to do wave check in Ni, because it will be done in routing unit and arbitrator
+
+    RoutingAlgorithm routing_algo =
+        (RoutingAlgorithm) m_net_ptr->getRoutingAlgorithm();
+    // TDM: hold flits whose first hop is closed in the wave the router
+    // will check, instead of letting them stall or misroute at Local
+    Cycles injection_wave = Cycles(0);
+    if (routing_algo == TDM_)
+        injection_wave = getInjectionWave();
+
     for (int i = 0; i < m_num_vcs; i++) {
         vc++;
         if (vc == m_num_vcs)
@@ -759,6 +776,17 @@ NetworkInterface::scheduleOutputLink()
             if (!is_candidate_vc)
                 continue;
 
+            if (routing_algo == TDM_ &&
+                !isFirstHopOpen(m_ni_out_vcs[vc]->peekTopFlit(),
+                                injection_wave)) {
+                // count cycles with a held flit, not held VCs
+                if (m_last_wave_stall != curCycle()) {
+                    m_last_wave_stall = curCycle();
+                    m_net_ptr->increment_injection_wave_stalls();
+                }
+                continue;
+            }
+
             m_vc_round_robin = vc;
 
             m_out_vc_state[vc]->decrement_credit();
@@ -769,8 +797,6 @@ NetworkInterface::scheduleOutputLink()
             // schedule the out link
             outNetLink->scheduleEventAbsolute(clockEdge(Cycles(1)));
             //new added for deflection
-            RoutingAlgorithm routing_algo =
-            (RoutingAlgorithm) m_net_ptr->getRoutingAlgorithm();
             if(routing_algo == DEFLECTION_ || routing_algo == TDM_){
                 m_ni_out_vcs_enqueue_time[vc] = Cycles(INFINITE_);
             }else{
@@ -784,6 +810,31 @@ NetworkInterface::scheduleOutputLink()
     }
 }
 
+// Wave in which the first router checks the outport of a flit sent
+// this cycle: one cycle to the out link, the link latency, the router
+// pipeline, and switch allocation looking one wave ahead.
+Cycles
+NetworkInterface::getInjectionWave()
+{
+    Router *router = m_net_ptr->m_routers[m_router_id];
+    Cycles delay = Cycles(1) + outNetLink->get_latency() +
+        router->get_pipe_stages();
+    return (curWave() + delay) % getWaveNum();
+}
+
+// Can the first router send this flit out of one of its candidate
+// outports in the given wave? Local outports are always open.
+bool
+NetworkInterface::isFirstHopOpen(flit *t_flit, Cycles wave)
+{
+    RoutingUnit *routing_unit =
+        m_net_ptr->m_routers[m_router_id]->get_rtUnit_ptr();
+    RouteInfo route = t_flit->get_route();
+    uint64_t candidates =
+        routing_unit->getCandidateOutports(route.vnet, route.dest_ni);
+    return (candidates & routing_unit->getOpenOutports(wave)) != 0;
+}
+
 int
 NetworkInterface::get_vnet(int vc)
 {
@@ -47,6 +47,7 @@
 //#include "mem/ruby/network/garnet2.0/GarnetNetwork.hh"
 #include "mem/ruby/network/garnet2.0/NetworkLink.hh"
 #include "mem/ruby/network/garnet2.0/OutVcState.hh"
+#include "mem/ruby/network/garnet2.0/ReorderBuffer.hh"
 #include "mem/ruby/slicc_interface/Message.hh"
 #include "params/GarnetNetworkInterface.hh"
 
@@ -104,6 +105,8 @@ class NetworkInterface : public ClockedObject, public Consumer
     std::vector<OutVcState *> m_out_vc_state;
     std::vector<int> m_vc_allocator;
     int m_vc_round_robin; // For round robin scheduling
+    uint32_t m_packet_seq; // packets flitisized so far
+    Cycles m_last_wave_stall; // last cycle a flit was held for its wave
     flitBuffer *outFlitQueue; // For modeling link contention
     flitBuffer *outCreditQueue;
     int m_deadlock_threshold;
@@ -130,7 +133,7 @@ class NetworkInterface : public ClockedObject, public Consumer
     std::vector<int> vc_busy_counter;
 
     //new added for deflection
-    std::map<int,int> m_rob;
+    ReorderBuffer m_rob;
     bool areAllFlitsHere(flit *t_flit);
 
     bool checkStallQueue();
@@ -138,6 +141,9 @@ class NetworkInterface : public ClockedObject, public Consumer
     int calculateVC(int vnet);
 
     void scheduleOutputLink();
+    //added for TDM
+    Cycles getInjectionWave();
+    bool isFirstHopOpen(flit *t_flit, Cycles wave);
     void checkReschedule();
     void sendCredit(flit *t_flit, bool is_free);
 
@@ -39,9 +39,10 @@ NetworkLink::NetworkLink(const Params *p)
     : ClockedObject(p), Consumer(this), m_id(p->link_id),
       m_type(NUM_LINK_TYPES_),
       m_latency(p->link_latency),
-      linkBuffer(new flitBuffer()), link_consumer(nullptr),
+      linkBuffer(new flitBuffer(RING_BUFFER_)), link_consumer(nullptr),
       link_srcQueue(nullptr), m_link_utilized(0),
-      m_vc_load(p->vcs_per_vnet * p->virt_nets)
+      m_vc_load(p->vcs_per_vnet * p->virt_nets), m_open_waves(0),
+      m_wave_flits(MAX_WAVES_), m_wave_blocked(MAX_WAVES_)
 {
 }
 
@@ -83,6 +84,11 @@ NetworkLink::resetStats()
     }
 
     m_link_utilized = 0;
+
+    for (int i = 0; i < MAX_WAVES_; i++) {
+        m_wave_flits[i] = 0;
+        m_wave_blocked[i] = 0;
+    }
 }
 
 NetworkLink *
@@ -65,6 +65,17 @@ class NetworkLink : public ClockedObject, public Consumer
     unsigned int getLinkUtilization() const { return m_link_utilized; }
     const std::vector<unsigned int> & getVcLoad() const { return m_vc_load; }
 
+    // TDM: waves scheduled on this link, flits the upstream router sent
+    // in each wave, and flits that wanted the link in a closed wave
+    void setOpenWaves(uint64_t waves) { m_open_waves = waves; }
+    uint64_t getOpenWaves() const { return m_open_waves; }
+    void incrementWaveFlits(int wave) { m_wave_flits[wave]++; }
+    void incrementWaveBlocked(int wave) { m_wave_blocked[wave]++; }
+    const std::vector<unsigned int> &
+    getWaveFlits() const { return m_wave_flits; }
+    const std::vector<unsigned int> &
+    getWaveBlocked() const { return m_wave_blocked; }
+
     inline bool isReady(Cycles curTime)
     { return linkBuffer->isReady(curTime); }
 
@@ -87,6 +98,9 @@ class NetworkLink : public ClockedObject, public Consumer
     // Statistical variables
     unsigned int m_link_utilized;
     std::vector<unsigned int> m_vc_load;
+    uint64_t m_open_waves;
+    std::vector<unsigned int> m_wave_flits;
+    std::vector<unsigned int> m_wave_blocked;
 };
 
 #endif // __MEM_RUBY_NETWORK_GARNET2_0_NETWORKLINK_HH__
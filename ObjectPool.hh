@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2019 Georgia Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Chen Chen
+ */
+
+
+#ifndef __MEM_RUBY_NETWORK_GARNET2_0_OBJECTPOOL_HH__
+#define __MEM_RUBY_NETWORK_GARNET2_0_OBJECTPOOL_HH__
+
+#include <cassert>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Recycling allocator for objects that are created and destroyed every
+// cycle (flits and credits).
+// Storage is carved out of slabs of m_slab_size objects that live as long
+// as the pool; released objects are destroyed and their storage is pushed
+// on a free list, so once the pool has grown to the number of objects in
+// flight, allocate() and release() do not touch the heap.
+
+template <class T>
+class ObjectPool
+{
+  public:
+    ObjectPool(int slab_size = 1024)
+        : m_slab_size(slab_size), m_num_allocated(0)
+    {
+        assert(m_slab_size > 0);
+    }
+
+    ~ObjectPool()
+    {
+        // objects still in flight are not destroyed
+        for (char *slab : m_slabs)
+            ::operator delete(slab);
+    }
+
+    template <typename... Args>
+    T *
+    allocate(Args&&... args)
+    {
+        if (m_free_list.empty())
+            grow();
+
+        void *storage = m_free_list.back();
+        m_free_list.pop_back();
+        m_num_allocated++;
+        return new (storage) T(std::forward<Args>(args)...);
+    }
+
+    void
+    release(T *obj)
+    {
+        assert(m_num_allocated > 0);
+        obj->~T();
+        m_free_list.push_back(obj);
+        m_num_allocated--;
+    }
+
+    // objects currently handed out
+    int get_num_allocated() const { return m_num_allocated; }
+    // objects the pool can hold without growing
+    int get_capacity() const { return m_slabs.size() * m_slab_size; }
+
+  private:
+    ObjectPool(const ObjectPool& obj);
+    ObjectPool& operator=(const ObjectPool& obj);
+
+    void
+    grow()
+    {
+        char *slab =
+            static_cast<char *>(::operator new(sizeof(T) * m_slab_size));
+        m_slabs.push_back(slab);
+        m_free_list.reserve(m_free_list.size() + m_slab_size);
+        // hand out the start of the slab first
+        for (int i = m_slab_size - 1; i >= 0; i--)
+            m_free_list.push_back(slab + i * sizeof(T));
+    }
+
+    const int m_slab_size;
+    int m_num_allocated;
+    std::vector<char *> m_slabs;
+    std::vector<void *> m_free_list;
+};
+
+#endif // __MEM_RUBY_NETWORK_GARNET2_0_OBJECTPOOL_HH__
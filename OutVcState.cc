@@ -70,8 +70,5 @@ void
 OutVcState::decrement_credit()
 {
     m_credit_count--;
-    //TODO:for deflection, looks like the system won't increase and decrease credit in order
-    //only god knows what happened here
-    //in MESH_XY, weight of link is 1, 2, but if in MESH_442 weight are identical, it will generate an error here
-    //assert(m_credit_count >= 0);
+    assert(m_credit_count >= 0);
 }
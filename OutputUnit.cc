@@ -51,7 +51,11 @@ OutputUnit::OutputUnit(int id, PortDirection direction, Router *router)
     m_router = router;
     m_num_vcs = m_router->get_num_vcs();
     m_vc_per_vnet = m_router->get_vc_per_vnet();
-    m_out_buffer = new flitBuffer();
+    m_out_buffer = new flitBuffer(RING_BUFFER_);
+
+    RoutingAlgorithm routing_algo =
+        (RoutingAlgorithm) m_router->get_net_ptr()->getRoutingAlgorithm();
+    m_count_credits = (routing_algo != DEFLECTION_ && routing_algo != TDM_);
 
     for (int i = 0; i < m_num_vcs; i++) {
         m_outvc_state.push_back(new OutVcState(i, m_router->get_net_ptr()));
@@ -71,7 +75,8 @@ OutputUnit::decrement_credit(int out_vc)
             "outvc %d at time: %lld\n",
             m_router->get_id(), m_id, out_vc, m_router->curCycle());
 
-    m_outvc_state[out_vc]->decrement_credit();
+    if (m_count_credits)
+        m_outvc_state[out_vc]->decrement_credit();
 }
 
 void
@@ -81,7 +86,8 @@ OutputUnit::increment_credit(int out_vc)
             "outvc %d at time: %lld\n",
             m_router->get_id(), m_id, out_vc, m_router->curCycle());
 
-    m_outvc_state[out_vc]->increment_credit();
+    if (m_count_credits)
+        m_outvc_state[out_vc]->increment_credit();
 }
 
 // Check if the output VC (i.e., input VC at next router)
@@ -249,7 +255,7 @@ OutputUnit::wakeup()
         if (t_credit->is_free_signal())
             set_vc_state(IDLE_, t_credit->get_vc(), m_router->curCycle());
 
-        delete t_credit;
+        m_router->get_net_ptr()->getCreditPool().release(t_credit);
     }
 }
 
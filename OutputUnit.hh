@@ -98,6 +98,18 @@ class OutputUnit : public Consumer
         m_out_link->scheduleEventAbsolute(m_router->clockEdge(Cycles(1)));
     }
 
+    // TDM wave usage of the out link
+    inline void
+    increment_wave_flits(int wave)
+    {
+        m_out_link->incrementWaveFlits(wave);
+    }
+    inline void
+    increment_wave_blocked(int wave)
+    {
+        m_out_link->incrementWaveBlocked(wave);
+    }
+
     uint32_t functionalWrite(Packet *pkt);
 
   private:
@@ -108,6 +120,10 @@ class OutputUnit : public Consumer
     Router *m_router;
     NetworkLink *m_out_link;
     CreditLink *m_credit_link;
+    // false for deflection/TDM: the downstream input VC never holds a
+    // non-Local flit past its arrival cycle, and ejected flits never
+    // block, so there are no buffer slots to count
+    bool m_count_credits;
 
     flitBuffer *m_out_buffer; // This is for the network link to consume
     std::vector<OutVcState *> m_outvc_state; // vc state of downstream router
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2019 Georgia Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Chen Chen
+ */
+
+
+
+#include "mem/ruby/network/garnet2.0/ReorderBuffer.hh"
+
+#include <cassert>
+
+ReorderBuffer::ReorderBuffer(int capacity)
+    : m_occupancy(0)
+{
+    int size = 1;
+    while (size < capacity)
+        size <<= 1;
+    m_table.resize(size);
+    m_mask = size - 1;
+}
+
+// home slot of a packet id
+int
+ReorderBuffer::slotOf(uint64_t packet_id) const
+{
+    // 64-bit finalizer, consecutive ids spread over the table
+    uint64_t h = packet_id;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h & m_mask;
+}
+
+bool
+ReorderBuffer::arrive(uint64_t packet_id, int num_flits, Cycles curTime,
+                      Cycles &first_arrival)
+{
+    assert(num_flits > 1);
+
+    int slot = slotOf(packet_id);
+    while (m_table[slot].num_arrived != 0 &&
+           m_table[slot].packet_id != packet_id)
+        slot = (slot + 1) & m_mask;
+
+    Entry &entry = m_table[slot];
+    if (entry.num_arrived == 0) {
+        // first flit of a new packet
+        entry.packet_id = packet_id;
+        entry.num_arrived = 1;
+        entry.first_arrival = curTime;
+        m_occupancy++;
+        if (2 * m_occupancy > (int)m_table.size())
+            grow();
+        return false;
+    }
+
+    entry.num_arrived++;
+    assert(entry.num_arrived <= num_flits);
+    if (entry.num_arrived < num_flits)
+        return false;
+
+    first_arrival = entry.first_arrival;
+    erase(slot);
+    return true;
+}
+
+// Backward shift deletion: move later entries of the probe sequence into
+// the hole, so lookups never need tombstones
+void
+ReorderBuffer::erase(int slot)
+{
+    m_occupancy--;
+    int hole = slot;
+    int next = (hole + 1) & m_mask;
+    while (m_table[next].num_arrived != 0) {
+        int home = slotOf(m_table[next].packet_id);
+        // can the entry at next move back to the hole?
+        if (((next - home) & m_mask) >= ((next - hole) & m_mask)) {
+            m_table[hole] = m_table[next];
+            hole = next;
+        }
+        next = (next + 1) & m_mask;
+    }
+    m_table[hole] = Entry();
+}
+
+void
+ReorderBuffer::grow()
+{
+    std::vector<Entry> old_table(2 * m_table.size());
+    old_table.swap(m_table);
+    m_mask = m_table.size() - 1;
+    for (const Entry &entry : old_table) {
+        if (entry.num_arrived == 0)
+            continue;
+        int slot = slotOf(entry.packet_id);
+        while (m_table[slot].num_arrived != 0)
+            slot = (slot + 1) & m_mask;
+        m_table[slot] = entry;
+    }
+}
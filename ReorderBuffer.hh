@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2019 Georgia Institute of Technology
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Authors: Chen Chen
+ */
+
+
+#ifndef __MEM_RUBY_NETWORK_GARNET2_0_REORDERBUFFER_HH__
+#define __MEM_RUBY_NETWORK_GARNET2_0_REORDERBUFFER_HH__
+
+#include <cstdint>
+#include <vector>
+
+#include "base/types.hh"
+
+// Reassembly state of the multi-flit packets that an NI is receiving
+// under deflection routing, where the flits of a packet arrive in any
+// order. Open addressing with linear probing, keyed by packet id; the
+// table doubles when it gets half full, so it settles at the maximum
+// number of packets outstanding at this NI.
+
+class ReorderBuffer
+{
+  public:
+    ReorderBuffer(int capacity = 16);
+
+    // Record the arrival of one flit of packet packet_id (of num_flits
+    // flits) at time curTime. Returns true when this was the last flit,
+    // and then frees the entry and sets first_arrival to the arrival
+    // time of the packet's first flit.
+    bool arrive(uint64_t packet_id, int num_flits, Cycles curTime,
+                Cycles &first_arrival);
+
+    // packets with some but not all flits received
+    int get_occupancy() const { return m_occupancy; }
+
+  private:
+    struct Entry
+    {
+        uint64_t packet_id;
+        int num_arrived;        // 0: free slot
+        Cycles first_arrival;
+        Entry() : packet_id(0), num_arrived(0), first_arrival(0) {}
+    };
+
+    int slotOf(uint64_t packet_id) const;
+    void erase(int slot);
+    void grow();
+
+    std::vector<Entry> m_table;
+    uint64_t m_mask;
+    int m_occupancy;
+};
+
+#endif // __MEM_RUBY_NETWORK_GARNET2_0_REORDERBUFFER_HH__
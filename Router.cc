@@ -54,26 +54,14 @@ Router::Router(const Params *p)
     m_virtual_networks = p->virt_nets;
     m_vc_per_vnet = p->vcs_per_vnet;
     m_num_vcs = m_virtual_networks * m_vc_per_vnet;
-    mrkd_flt_ = 0;//p->marked_flit;//TODO
+    mrkd_flt_ = 0; // set by GarnetNetwork::init for sim_type 2
     m_routing_unit = new RoutingUnit(this);
     m_sw_alloc = new SwitchAllocator(this);
     m_switch = new CrossbarSwitch(this);
 
     m_input_unit.clear();
     m_output_unit.clear();
-    outport_allocation_tracker.resize(10);
-    //TODO
-    m_router_inport_dirn2id["West"] = 0;
-    m_router_inport_dirn2id["South"] = 1;
-    m_router_inport_dirn2id["East"] = 2;
-    m_router_inport_dirn2id["North"] = 3;
-    m_router_inport_dirn2id["Local"] = 4;
-    //for wave allocation
-    m_router_outport_dirn2id["South"] = 5;
-    m_router_outport_dirn2id["West"] = 3;
-    m_router_outport_dirn2id["East"] = 4;
-    m_router_outport_dirn2id["North"] = 2;
-
+    outport_allocation_tracker.clear();
 }
 
 Router::~Router()
@@ -90,6 +78,21 @@ Router::init()
 {
     BasicRouter::init();
 
+    // the TDM schedule is kept as one bit per wave
+    RoutingAlgorithm routing_algo =
+        (RoutingAlgorithm) get_net_ptr()->getRoutingAlgorithm();
+    fatal_if(routing_algo == TDM_ && getWaveNum() > MAX_WAVES_,
+             "Router %d: TDM supports at most %d waves, wave number is %d",
+             m_id, MAX_WAVES_, (int)getWaveNum());
+    // a flit routed to a link without waves would wait for it forever
+    for (int outport = 0; outport < m_output_unit.size(); outport++) {
+        fatal_if(routing_algo == TDM_ &&
+                 !m_routing_unit->is_local_outport(outport) &&
+                 m_routing_unit->getWaveCount(outport) == 0,
+                 "Router %d: outport %s has no waves in the TDM schedule",
+                 m_id, getPortDirectionName(getOutportDirection(outport)));
+    }
+
     m_sw_alloc->init();
     m_switch->init();
 }
@@ -138,6 +141,7 @@ Router::addInPort(PortDirection inport_dirn,
     credit_link->setSourceQueue(input_unit->getCreditQueue());
 
     m_input_unit.push_back(input_unit);
+    outport_allocation_tracker.resize(m_input_unit.size());
 
     m_routing_unit->addInDirection(inport_dirn, port_num);
 }
@@ -181,8 +185,9 @@ Router::addOutPort(PortDirection outport_dirn,
     m_routing_unit->addRoute(routing_table_entry);
     m_routing_unit->addWeight(link_weight);
     m_routing_unit->addOutDirection(outport_dirn, port_num);
-    if(outport_dirn != "Local"){ // only alloc wave on non-local link
-        m_routing_unit->addWave(m_wave, m_routing_unit->outport_dirn2id(outport_dirn));
+    if(!m_routing_unit->is_local_outport(port_num)){ // only alloc wave on non-local link
+        m_routing_unit->addWave(m_wave, port_num);
+        out_link->setOpenWaves(m_routing_unit->getOutportWaves(port_num));
     }
 }
 
@@ -339,6 +344,7 @@ Router::functionalWrite(Packet *pkt)
 {
     uint32_t num_functional_writes = 0;
     num_functional_writes += m_switch->functionalWrite(pkt);
+    num_functional_writes += m_sw_alloc->functionalWrite(pkt);
 
     for (uint32_t i = 0; i < m_input_unit.size(); i++) {
         num_functional_writes += m_input_unit[i]->functionalWrite(pkt);
@@ -355,7 +361,7 @@ Router::functionalWrite(Packet *pkt)
 void Router::display_struct(){
 
     std::cout << "\n-----id=" << m_id << "-------" << curCycle() << "---------";
-    for(int i=0; i<5; ++i){
+    for(int i=0; i<outport_allocation_tracker.size(); ++i){
         std::cout << "\nO = " << outport_allocation_tracker[i].outport;
         std::cout << "\tT= " << outport_allocation_tracker[i].time;
     }
@@ -380,7 +386,7 @@ bool Router::lookup_outport_allocation_tracker(int out){
     for(int i = 0; i < m_input_unit.size(); i++){
         if(outport_allocation_tracker[i].outport == out){
             if(outport_allocation_tracker[i].time == curCycle()){
-                if(m_routing_unit->inport_id2dirn(i) != "Local")
+                if(!m_routing_unit->is_local_inport(i))
                     return false;
             }
         }
@@ -390,44 +396,31 @@ bool Router::lookup_outport_allocation_tracker(int out){
 }
 
 
-//unnecessary to use out_dirn as parameter, outport id also works
-bool Router::nextWaveChecker(Cycles nextWave, PortDirection out_dirn){ // TODO require a direction change here
-    int port = m_routing_unit->outport_dirn2id(out_dirn);
-    m_wave_table = m_routing_unit->get_wvTable_ref();
-    assert(out_dirn != "Local" && m_wave_table[port].size() > 0); // make sure the port not from Local, and has wave on it
-
-    Cycles outportWave = Cycles(0);
-
-    for(int i = 0; i < m_wave_table[port].size(); i++){
-        outportWave = Cycles(m_wave_table[port][i]);
-        if(outportWave == nextWave)
-            return true;
-    }
+bool Router::nextWaveChecker(Cycles nextWave, int outport){
+    // make sure the port not from Local, and has wave on it
+    assert(!m_routing_unit->is_local_outport(outport) &&
+           m_routing_unit->getWaveCount(outport) > 0);
+    return m_routing_unit->isOutportOpen(outport, nextWave);
+}
 
-    return false;
+Cycles Router::getNextWave(){
+    return getWaveAfter(Cycles(1));
+}
 
+// the wave is advanced every cycle
+Cycles Router::getWaveAfter(Cycles delay){
+    return (curWave() + delay) % getWaveNum();
 }
 
 bool Router::isLinkAvaliable(int port_num){
-    if(m_output_unit[port_num]->get_direction() == "Local"){
-        return true;
-    }else{
-        Cycles cur_wave = curWave();
-        Cycles wave_num = getWaveNum();
-        Cycles next_wave = (cur_wave + Cycles(1)) % wave_num;
-        
-        m_wave_table = m_routing_unit->get_wvTable_ref();
-        assert(m_wave_table[port_num].size() > 0);
-        Cycles outportWave = Cycles(0);
-
-        for(int i = 0; i < m_wave_table[port_num].size(); i++){
-            outportWave = Cycles(m_wave_table[port_num][i]);
-            if(outportWave == next_wave)
-                return true;
-        }
-    }
+    assert(m_routing_unit->is_local_outport(port_num) ||
+           m_routing_unit->getWaveCount(port_num) > 0);
+    return m_routing_unit->isOutportOpen(port_num, getNextWave());
+}
 
-    return false;
+// bit p is set if outport p can be used in the next wave
+uint64_t Router::getNextWaveOutports(){
+    return m_routing_unit->getOpenOutports(getNextWave());
 }
 
 int Router::getWaveDirection(const std::vector<int> &pref, PortDirection in_dirn, int inport){
@@ -435,17 +428,13 @@ int Router::getWaveDirection(const std::vector<int> &pref, PortDirection in_dirn
     if(cur_cycle == Cycles(0)){
         return 0;
     } // TODO take attention here 
-    Cycles cur_wave = curWave();
-    Cycles wave_num = getWaveNum();
-    Cycles next_wave = (cur_wave + Cycles(1)) % wave_num;
+    Cycles next_wave = getNextWave();
 
     std::vector<int> output_link_candidates;
     int num_candidates = 0;
-    PortDirection curr_dirn;
     bool outport_avaliable = false;
 
     //inportIndex = m_routing_unit->inport_dirn2id(in_dirn);
-    assert(in_dirn == getInportDirection(inport));
     m_input_unit[inport]->reset_flag();
 
     for(int i = 0; i < pref.size(); i++){
@@ -462,10 +451,10 @@ int Router::getWaveDirection(const std::vector<int> &pref, PortDirection in_dirn
         if(pref_available){
             //check this outport has corresponding next wave
             //local outport doesn't require to check next wave
-            if(m_routing_unit->outport_id2dirn(pref[i]) == "Local")
+            if(m_routing_unit->is_local_outport(pref[i]))
                 outport_avaliable = true;
             else
-                outport_avaliable = nextWaveChecker(next_wave, m_routing_unit->outport_id2dirn(pref[i])); //TODO require convert here
+                outport_avaliable = nextWaveChecker(next_wave, pref[i]);
             
             if(outport_avaliable){
                 num_candidates++;
@@ -490,13 +479,10 @@ int Router::getWaveDirection(const std::vector<int> &pref, PortDirection in_dirn
     //Check for possible misroutes
 
     for (int outport = 0; outport < m_output_unit.size(); outport++) {
-        
-        curr_dirn = m_routing_unit->outport_id2dirn(outport);
-        
         if(lookup_outport_allocation_tracker(outport)){
-            if(curr_dirn != "Local"){
+            if(!m_routing_unit->is_local_outport(outport)){
                 //each non-local outport direction only has one correspoding outport id
-                outport_avaliable = nextWaveChecker(next_wave, curr_dirn);
+                outport_avaliable = nextWaveChecker(next_wave, outport);
                 if(outport_avaliable){
                     m_input_unit[inport]->set_flag(true);
                     backup = outport;
@@ -507,7 +493,7 @@ int Router::getWaveDirection(const std::vector<int> &pref, PortDirection in_dirn
     }
 
     //flit in local has to stall in this cycle
-    if(backup == -1 && in_dirn == "Local"){
+    if(backup == -1 && m_routing_unit->is_local_inport(inport)){
         //havent found a proper outport
         m_input_unit[inport]->set_flag(false);
         backup = pref[0];
@@ -523,7 +509,7 @@ int Router::getWaveDirection(const std::vector<int> &pref, PortDirection in_dirn
 int Router::getAllocatedDirection(int pref, PortDirection in_dirn, int inport){
 
     int backup = -1;
-    PortDirection curr_dirn;
+    int in_dirn_id = m_routing_unit->inport_dirn_id(inport);
 
     bool pref_available = lookup_outport_allocation_tracker(pref);
     
@@ -550,20 +536,18 @@ int Router::getAllocatedDirection(int pref, PortDirection in_dirn, int inport){
     // }
 
     for (int outport = 0; outport < m_output_unit.size(); outport++) {
-        
-        curr_dirn = m_routing_unit->outport_id2dirn(outport);
-        
         if(lookup_outport_allocation_tracker(outport)){
-            if(curr_dirn != "Local"){
+            if(!m_routing_unit->is_local_outport(outport)){
                 backup = outport;
-                if(in_dirn != curr_dirn)    break;
+                if(in_dirn_id != m_routing_unit->outport_dirn_id(outport))
+                    break;
             }
         }
     }
 
     //No backup ports available, allocate the flit that in being Injected
     //as it would be given least priority
-    if((backup==-1) && in_dirn=="Local")
+    if((backup==-1) && m_routing_unit->is_local_inport(inport))
         backup = pref;
 
     //make sure all incoming flit have been allocated an outport
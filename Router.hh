@@ -37,6 +37,7 @@
 #include <iostream>
 #include <vector>
 #include <map>
+#include <set>
 
 #include "mem/ruby/common/Consumer.hh"
 #include "mem/ruby/common/NetDest.hh"
@@ -111,9 +112,36 @@ class Router : public BasicRouter, public Consumer
     bool lookup_outport_allocation_tracker(int out);
     void display_struct();
     //added for TDM
-    bool nextWaveChecker(Cycles nextWave, PortDirection out_dirn);
+    bool nextWaveChecker(Cycles nextWave, int outport);
     int getWaveDirection(const std::vector<int> &pref, PortDirection in_dirn, int inport);
     bool isLinkAvaliable(int port_num);
+    Cycles getNextWave();
+    Cycles getWaveAfter(Cycles delay);
+    uint64_t getNextWaveOutports();
+
+    // SA-ready cycles of the flits buffered in the input VCs, kept up to
+    // date by the InputUnits so that the SwitchAllocator can tell in O(1)
+    // whether it is needed next cycle.
+    inline void
+    sa_flit_inserted(Cycles sa_time)
+    {
+        m_sa_ready_times.insert(sa_time);
+    }
+
+    inline void
+    sa_flit_removed(Cycles sa_time)
+    {
+        auto it = m_sa_ready_times.find(sa_time);
+        assert(it != m_sa_ready_times.end());
+        m_sa_ready_times.erase(it);
+    }
+
+    inline bool
+    sa_ready_by(Cycles time)
+    {
+        return (!m_sa_ready_times.empty() &&
+                *m_sa_ready_times.begin() <= time);
+    }
 
     int route_compute(RouteInfo route, int inport, PortDirection direction);
     int route_compute(RouteInfo route, int inport, PortDirection direction, int invc); //New Addition
@@ -159,6 +187,8 @@ class Router : public BasicRouter, public Consumer
     std::vector<OutputUnit *> m_output_unit;
     std::vector<Router *>m_adj_router;
 
+    std::multiset<Cycles> m_sa_ready_times;
+
     RoutingUnit *m_routing_unit;
     SwitchAllocator *m_sw_alloc;
     CrossbarSwitch *m_switch;
@@ -174,12 +204,6 @@ class Router : public BasicRouter, public Consumer
 
     //outport_allocation_tracker_struct outport_allocation_tracker[5];
     std::vector<outport_allocation_tracker_struct> outport_allocation_tracker;
-    std::map <PortDirection, int> m_router_inport_dirn2id;
-
-    std::map <PortDirection, int> m_router_outport_dirn2id;
-
-    //added for TDM
-    std::vector<vector<int>> m_wave_table;
 };
 
 #endif // __MEM_RUBY_NETWORK_GARNET2_0_ROUTER_HH__
@@ -33,8 +33,11 @@
 
 #include "mem/ruby/network/garnet2.0/RoutingUnit.hh"
 
+#include <algorithm>
+
 #include "base/cast.hh"
 #include "base/logging.hh"
+#include "debug/RubyNetwork.hh"
 #include "mem/ruby/network/garnet2.0/InputUnit.hh"
 #include "mem/ruby/network/garnet2.0/Router.hh"
 #include "mem/ruby/slicc_interface/Message.hh"
@@ -44,15 +47,10 @@ RoutingUnit::RoutingUnit(Router *router)
     m_router = router;
     m_routing_table.clear();
     m_weight_table.clear();
-    m_wave_table.clear();
-
-    // while(m_wave_table.size() < 6){
-    //     std::vector<int> tmp_wave_table;
-    //     m_wave_table.push_back(tmp_wave_table);
-    // }
 
-    m_wave_table.resize(10);
-    //std::cout<<"ruunit::mwavetable size is "<<m_wave_table.size()<<endl;
+    m_outport_wave_mask.clear();
+    m_wave_outport_mask.assign(MAX_WAVES_, 0);
+    m_local_outport_mask = 0;
 }
 
 void
@@ -70,22 +68,34 @@ RoutingUnit::addWeight(int link_weight)
 void
 RoutingUnit::addWave(const std::vector<int>& link_wave, int outport)
 {
+    DPRINTF(RubyNetwork, "Router %d outport %d carries %d waves\n",
+            m_router->get_id(), outport, link_wave.size());
 
-    std:: cout <<"\n================addWave in rot unit section ==============="<<endl;
-    std:: cout << "ROuter id "<< m_router->get_id() << "outport position" << outport <<endl;
-    std::cout <<"wave add in: ";    
-    std::cout << "size of this ourport wave is "<<link_wave.size()<<endl;
-    if(outport > 9){
-        panic("size of wave table is not enough, increase in RoutingUnit constractor");
-    }
-    m_wave_table[outport].clear();
+    fatal_if(outport >= MAX_MASK_PORTS_,
+             "Router %d: TDM supports at most %d outports",
+             m_router->get_id(), MAX_MASK_PORTS_);
+
+    // Compile the wave list into masks here, so that the per-flit
+    // checks in the Router and SwitchAllocator are single-word lookups
+    uint64_t wave_mask = 0;
     for(int waveNum = 0; waveNum < link_wave.size(); waveNum++){
-        m_wave_table[outport].push_back(link_wave[waveNum]);
-        std::cout << link_wave[waveNum]<<" ";
+        int wave = link_wave[waveNum];
+        fatal_if(wave < 0 || wave >= MAX_WAVES_,
+                 "Router %d outport %d: wave %d is outside [0, %d)",
+                 m_router->get_id(), outport, wave, MAX_WAVES_);
+        wave_mask |= (1ULL << wave);
     }
-    std::cout <<"\n=====================current link end===================="<<endl;
 
+    if (m_outport_wave_mask.size() <= outport)
+        m_outport_wave_mask.resize(outport + 1, 0);
+    m_outport_wave_mask[outport] = wave_mask;
 
+    for (int wave = 0; wave < MAX_WAVES_; wave++) {
+        if ((wave_mask >> wave) & 1)
+            m_wave_outport_mask[wave] |= (1ULL << outport);
+        else
+            m_wave_outport_mask[wave] &= ~(1ULL << outport);
+    }
 }
 
 /*
@@ -144,20 +154,142 @@ RoutingUnit::lookupRoutingTable(int vnet, NetDest msg_destination)
     return output_link;
 }
 
+// Called by GarnetNetwork::init() after Topology::createLinks(),
+// when the routing and weight tables are complete.
+void
+RoutingUnit::buildRoutingCache()
+{
+    int num_nodes = 0;
+    for (int link = 0; link < m_routing_table.size(); link++) {
+        for (NodeID node : m_routing_table[link].getAllDest())
+            num_nodes = std::max(num_nodes, (int)node + 1);
+    }
+
+    std::vector<int> min_weight(num_nodes, INFINITE_);
+    std::vector<std::vector<int>> candidates(num_nodes);
+    for (int link = 0; link < m_routing_table.size(); link++) {
+        for (NodeID node : m_routing_table[link].getAllDest()) {
+            if (m_weight_table[link] < min_weight[node]) {
+                min_weight[node] = m_weight_table[link];
+                candidates[node].clear();
+            }
+            if (m_weight_table[link] == min_weight[node])
+                candidates[node].push_back(link);
+        }
+    }
+
+    m_cache_outports.clear();
+    m_cache_offset.assign(1, 0);
+    m_cache_mask.assign(num_nodes, 0);
+    for (int node = 0; node < num_nodes; node++) {
+        for (int link : candidates[node]) {
+            m_cache_outports.push_back(link);
+            if (link < MAX_MASK_PORTS_)
+                m_cache_mask[node] |= (uint64_t)1 << link;
+        }
+        m_cache_offset.push_back(m_cache_outports.size());
+    }
+    m_candidates.reserve(m_routing_table.size());
+
+    DPRINTF(RubyNetwork, "Router %d: routing cache for %d nodes, "
+            "%d candidates\n", m_router->get_id(), num_nodes,
+            m_cache_outports.size());
+}
+
+int
+RoutingUnit::lookupRoutingTable(int vnet, int dest_ni)
+{
+    assert(dest_ni + 1 < m_cache_offset.size());
+    int first = m_cache_offset[dest_ni];
+    int num_candidates = m_cache_offset[dest_ni + 1] - first;
+
+    if (num_candidates == 0) {
+        fatal("Fatal Error:: No Route exists from Router %d to node %d.",
+              m_router->get_id(), dest_ni);
+    }
+
+    // Randomly select any candidate output link
+    int candidate = 0;
+    if (!(m_router->get_net_ptr())->isVNetOrdered(vnet))
+        candidate = rand() % num_candidates;
+
+    return m_cache_outports[first + candidate];
+}
+
+uint64_t
+RoutingUnit::getCandidateOutports(int vnet, int dest_ni)
+{
+    assert(dest_ni < m_cache_mask.size());
+    uint64_t candidates = m_cache_mask[dest_ni];
+
+    // ordered vnets always take the first candidate
+    if ((m_router->get_net_ptr())->isVNetOrdered(vnet))
+        candidates &= -candidates;
+
+    return candidates;
+}
+
 
 void
 RoutingUnit::addInDirection(PortDirection inport_dirn, int inport_idx)
 {
-    m_inports_dirn2idx[inport_dirn] = inport_idx;
+    int dirn_id = m_router->get_net_ptr()->getDirectionId(inport_dirn);
+
+    if (m_inports_idx2dirn.size() <= inport_idx) {
+        m_inports_idx2dirn.resize(inport_idx + 1);
+        m_inports_idx2dirn_id.resize(inport_idx + 1, -1);
+        m_inport_is_local.resize(inport_idx + 1, false);
+    }
+    if (m_inports_dirn_id2idx.size() <= dirn_id)
+        m_inports_dirn_id2idx.resize(dirn_id + 1, -1);
+
+    m_inports_dirn_id2idx[dirn_id] = inport_idx;
     m_inports_idx2dirn[inport_idx]  = inport_dirn;
+    m_inports_idx2dirn_id[inport_idx] = dirn_id;
+    m_inport_is_local[inport_idx] = (dirn_id == LOCAL_DIRN_);
 }
 
 void
 RoutingUnit::addOutDirection(PortDirection outport_dirn, int outport_idx)
 {
     //std::cout<<"\n\nrtunit, outdirection setup outport_dirn outport_idx "<< outport_dirn <<" "<< outport_idx<<endl;
-    m_outports_dirn2idx[outport_dirn] = outport_idx;
+    int dirn_id = m_router->get_net_ptr()->getDirectionId(outport_dirn);
+
+    if (m_outports_idx2dirn.size() <= outport_idx) {
+        m_outports_idx2dirn.resize(outport_idx + 1);
+        m_outports_idx2dirn_id.resize(outport_idx + 1, -1);
+        m_outport_is_local.resize(outport_idx + 1, false);
+    }
+    if (m_outports_dirn_id2idx.size() <= dirn_id)
+        m_outports_dirn_id2idx.resize(dirn_id + 1, -1);
+
+    m_outports_dirn_id2idx[dirn_id] = outport_idx;
     m_outports_idx2dirn[outport_idx]  = outport_dirn;
+    m_outports_idx2dirn_id[outport_idx] = dirn_id;
+    m_outport_is_local[outport_idx] = (dirn_id == LOCAL_DIRN_);
+
+    // Local outports are open in every wave
+    if (m_outport_wave_mask.size() <= outport_idx)
+        m_outport_wave_mask.resize(outport_idx + 1, 0);
+    if (m_outport_is_local[outport_idx] && outport_idx < MAX_MASK_PORTS_) {
+        m_outport_wave_mask[outport_idx] = ~0ULL;
+        m_local_outport_mask |= (1ULL << outport_idx);
+    }
+}
+
+int
+RoutingUnit::outport_dirn2id(PortDirection dirn)
+{
+    return outport_dirn_id2idx(m_router->get_net_ptr()->getDirectionId(dirn));
+}
+
+int
+RoutingUnit::inport_dirn2id(PortDirection dirn)
+{
+    int dirn_id = m_router->get_net_ptr()->getDirectionId(dirn);
+    assert(dirn_id < m_inports_dirn_id2idx.size() &&
+           m_inports_dirn_id2idx[dirn_id] != -1);
+    return m_inports_dirn_id2idx[dirn_id];
 }
 
 // outportCompute() is called by the InputUnit
@@ -182,7 +314,7 @@ RoutingUnit::outportCompute(RouteInfo route, int inport,
         // Multiple NIs may be connected to this router,
         // all with output port direction = "Local"
         // Get exact outport id from table
-        outport = lookupRoutingTable(route.vnet, route.net_dest);
+        outport = lookupRoutingTable(route.vnet, route.dest_ni);
         
         //To prevent multiple flits attempting to exit from Local
         if(routing_algorithm != DEFLECTION_ && routing_algorithm != TDM_)    
@@ -191,7 +323,7 @@ RoutingUnit::outportCompute(RouteInfo route, int inport,
 
     switch (routing_algorithm) {
         case TABLE_:  outport =
-            lookupRoutingTable(route.vnet, route.net_dest); break;
+            lookupRoutingTable(route.vnet, route.dest_ni); break;
         case XY_:     outport =
             outportComputeXY(route, inport, inport_dirn); break;
         case TURN_MODEL_: outport =
@@ -204,9 +336,9 @@ RoutingUnit::outportCompute(RouteInfo route, int inport,
         case CUSTOM_: outport =
             outportComputeCustom(route, inport, inport_dirn); break;
         case TDM_: outport = 
-            outportComputeTDM(route.vnet, route.net_dest, inport_dirn, inport); break;
+            outportComputeTDM(route, inport, inport_dirn); break;
         default: outport =
-            lookupRoutingTable(route.vnet, route.net_dest); break;
+            lookupRoutingTable(route.vnet, route.dest_ni); break;
     }
 
     assert(outport != -1);
@@ -230,7 +362,7 @@ RoutingUnit::outportCompute(RouteInfo route, int inport,
         // Multiple NIs may be connected to this router,
         // all with output port direction = "Local"
         // Get exact outport id from table
-        outport = lookupRoutingTable(route.vnet, route.net_dest);
+        outport = lookupRoutingTable(route.vnet, route.dest_ni);
         if(routing_algorithm != DEFLECTION_ && routing_algorithm != TDM_)
             return outport;
     }
@@ -239,7 +371,7 @@ RoutingUnit::outportCompute(RouteInfo route, int inport,
     // Can be over-ridden from command line using --routing-algorithm = 1
       switch (routing_algorithm) {
         case TABLE_:  outport =
-            lookupRoutingTable(route.vnet, route.net_dest); break;
+            lookupRoutingTable(route.vnet, route.dest_ni); break;
         case XY_:     outport =
             outportComputeXY(route, inport, inport_dirn); break;
         case TURN_MODEL_: outport =
@@ -255,9 +387,9 @@ RoutingUnit::outportCompute(RouteInfo route, int inport,
         case DEFLECTION_: outport = 
             outportComputeDeflection(route, inport, inport_dirn); break;
         case TDM_: outport = 
-            outportComputeTDM(route.vnet, route.net_dest, inport_dirn, inport); break;    
+            outportComputeTDM(route, inport, inport_dirn); break;    
         default: outport =
-            lookupRoutingTable(route.vnet, route.net_dest); break;
+            lookupRoutingTable(route.vnet, route.dest_ni); break;
     }
 
     assert(outport != -1);
@@ -279,7 +411,7 @@ RoutingUnit::outportCompute(RouteInfo route, int inport,
 //         // Multiple NIs may be connected to this router,
 //         // all with output port direction = "Local"
 //         // Get exact outport id from table
-//         outport = lookupRoutingTable(route.vnet, route.net_dest);
+//         outport = lookupRoutingTable(route.vnet, route.dest_ni);
 //         if(routing_algorithm != DEFLECTION_)
 //             return outport;
 //     }
@@ -288,7 +420,7 @@ RoutingUnit::outportCompute(RouteInfo route, int inport,
 //     // Can be over-ridden from command line using --routing-algorithm = 1
 //       switch (routing_algorithm) {
 //         case TABLE_:  outport =
-//             lookupRoutingTable(route.vnet, route.net_dest); break;
+//             lookupRoutingTable(route.vnet, route.dest_ni); break;
 //         case XY_:     outport =
 //             outportComputeXY(route, inport, inport_dirn); break;
 //         case TURN_MODEL_: outport =
@@ -306,7 +438,7 @@ RoutingUnit::outportCompute(RouteInfo route, int inport,
 //         case TDM_: outport = 
 //             outportComputeTDM(route.vnet, route.net_dest); break;    
 //         default: outport =
-//             lookupRoutingTable(route.vnet, route.net_dest); break;
+//             lookupRoutingTable(route.vnet, route.dest_ni); break;
 //     }
 
 //     assert(outport != -1);
@@ -372,7 +504,7 @@ RoutingUnit::outportComputeXY(RouteInfo route,
         panic("x_hops == y_hops == 0");
     }
 
-    return m_outports_dirn2idx[outport_dirn];
+    return outport_dirn2id(outport_dirn);
 }
 
 
@@ -387,7 +519,7 @@ RoutingUnit::outportComputeDeflection(RouteInfo route,
 
 
     //int preferred_outport = outportComputeRandom(route, inport, inport_dirn);
-    int preferred_outport = lookupRoutingTable(route.vnet, route.net_dest); // use this funx to find the destination, the weight to local is always 1
+    int preferred_outport = lookupRoutingTable(route.vnet, route.dest_ni); // use this funx to find the destination, the weight to local is always 1
     //int obtained = m_router->getAllocatedDirection(preferred_outport, inport_dirn, inport);
     
     
@@ -464,7 +596,7 @@ RoutingUnit::outportComputeTurnModel(RouteInfo route,
     
     //ANK modification ends
 
-    return m_outports_dirn2idx[outport_dirn];
+    return outport_dirn2id(outport_dirn);
 }
 
 int
@@ -521,70 +653,69 @@ RoutingUnit::outportComputeRandom(RouteInfo route,
             outport_dirn = rand ? "East" : "South";
     }
 
-    return m_outports_dirn2idx[outport_dirn];
+    return outport_dirn2id(outport_dirn);
 }
 
 int
-RoutingUnit::outportComputeTDM(int vnet, NetDest msg_destination,
-								PortDirection inport_dirn, int inport)
+RoutingUnit::outportComputeTDM(RouteInfo route, int inport,
+                               PortDirection inport_dirn)
 {
     //apply lookup to get the most suitable outport
     //if it is local, then goes local
     //TODO: change weight of local back to 1
     //all link weight should be 1
     //to express the shortest path
-    
-    int min_weight = INFINITE_;
-    std::vector<int> output_link_candidates;
-    bool uTurnFlag = false;
-    int num_candidates = 0;
-    int output_link = -1;
-    // Identify the minimum weight among the candidate output links
-    for (int link = 0; link < m_routing_table.size(); link++) {
-        if (msg_destination.intersectionIsNotEmpty(m_routing_table[link])) {
-
-        if (m_weight_table[link] <= min_weight)
-            min_weight = m_weight_table[link];
-        }
-    }
+    int vnet = route.vnet;
+    assert(route.dest_ni + 1 < m_cache_offset.size());
+    int first = m_cache_offset[route.dest_ni];
+    int last = m_cache_offset[route.dest_ni + 1];
 
-    //std::cout<<"\nrtunit================================================"<<endl;
-    //std::cout << "candi link id "; 
-    for (int link = 0; link < m_routing_table.size(); link++) {
-        if (msg_destination.intersectionIsNotEmpty(m_routing_table[link])) {
-            PortDirection outport_dirn = outport_id2dirn(link);
-            if (m_weight_table[link] == min_weight) { // make u turn as the least priority
-                if(outport_dirn != "Local"){
-                    if(outport_dirn != inport_dirn){                
-                        num_candidates++;
-                        output_link_candidates.push_back(link);
-                    }else{
-                        uTurnFlag = true;
-                    }
-                }else{
-                    num_candidates++;
-                    output_link_candidates.push_back(link);
-                }
-           }
+    bool uTurnFlag = false;
+    int inport_dirn_id = m_inports_idx2dirn_id[inport];
+    m_candidates.clear();
+    for (int i = first; i < last; i++) { // make u turn as the least priority
+        int link = m_cache_outports[i];
+        if (!m_outport_is_local[link] &&
+            m_outports_idx2dirn_id[link] == inport_dirn_id) {
+            uTurnFlag = true;
+        } else {
+            m_candidates.push_back(link);
         }
     }
 
-    if (output_link_candidates.size() == 0 && uTurnFlag == false) {
+    if (m_candidates.size() == 0 && uTurnFlag == false) {
         fatal("Fatal Error:: No Route exists from this Router.");
         exit(0);
-    }else if(output_link_candidates.size() == 0 && uTurnFlag == true){
+    }else if(m_candidates.size() == 0 && uTurnFlag == true){
         //only uturn has avaliable link
-        int preferred_outport = outport_dirn2id(inport_dirn);
+        int preferred_outport = outport_dirn_id2idx(inport_dirn_id);
         return preferred_outport;
     }
 
+    int num_candidates = m_candidates.size();
+
+    // Injected flits were released by the NI for a wave in which one of
+    // the candidates is open: keep only those open in the wave that
+    // switch allocation checks (pipeline stages + 1 cycles from now)
+    if (m_inport_is_local[inport] && num_candidates > 1 &&
+        !(m_router->get_net_ptr())->isVNetOrdered(vnet)) {
+        Cycles sa_wave = m_router->getWaveAfter(m_router->get_pipe_stages());
+        uint64_t open_outports = getOpenOutports(sa_wave);
+        int num_open = 0;
+        for (int i = 0; i < num_candidates; i++) {
+            if ((open_outports >> m_candidates[i]) & 1)
+                m_candidates[num_open++] = m_candidates[i];
+        }
+        if (num_open > 0)
+            num_candidates = num_open;
+    }
+
     // Randomly select any candidate output link
     int candidate = 0;
     if (!(m_router->get_net_ptr())->isVNetOrdered(vnet))
         candidate = rand() % num_candidates;
 
-    output_link = output_link_candidates.at(candidate);
-    return output_link;
+    return m_candidates[candidate];
 
     //May have multiple outport
     //apply deflection and wave function to determine which one
@@ -34,6 +34,7 @@
 #ifndef __MEM_RUBY_NETWORK_GARNET2_0_ROUTINGUNIT_HH__
 #define __MEM_RUBY_NETWORK_GARNET2_0_ROUTINGUNIT_HH__
 
+#include "base/bitfield.hh"
 #include "mem/ruby/common/Consumer.hh"
 #include "mem/ruby/common/NetDest.hh"
 #include "mem/ruby/network/garnet2.0/CommonTypes.hh"
@@ -67,8 +68,49 @@ class RoutingUnit
     void addRoute(const NetDest& routing_table_entry);
     void addWeight(int link_weight);
     void addWave(const std::vector<int> &link_wave, int outport);
+
+    // TDM schedule, compiled once in addWave()
+    // An outport is open in a wave if its link carries that wave.
+    // Local outports are always open.
+    inline bool
+    isOutportOpen(int outport, int wave)
+    {
+        return (m_outport_wave_mask[outport] >> wave) & 1;
+    }
+
+    // bit w is set if the outport is open in wave w
+    inline uint64_t
+    getOutportWaves(int outport)
+    {
+        return m_outport_wave_mask[outport];
+    }
+
+    // number of waves scheduled on this outport's link, 0 for Local
+    inline int
+    getWaveCount(int outport)
+    {
+        if (outport >= (int)m_outport_wave_mask.size() ||
+            m_outport_is_local[outport])
+            return 0;
+        return popCount(m_outport_wave_mask[outport]);
+    }
+
+    // bit p is set if outport p is open in the given wave
+    inline uint64_t
+    getOpenOutports(int wave)
+    {
+        return m_wave_outport_mask[wave] | m_local_outport_mask;
+    }
+
     // get output port from routing table
     int  lookupRoutingTable(int vnet, NetDest net_dest);
+    // same, from the next hop cache of unicast destination dest_ni
+    int  lookupRoutingTable(int vnet, int dest_ni);
+    // bit p is set if lookupRoutingTable() may return outport p
+    uint64_t getCandidateOutports(int vnet, int dest_ni);
+
+    // Build the next hop cache once all links have been added
+    void buildRoutingCache();
 
     // Topology-specific direction based routing
     void addInDirection(PortDirection inport_dirn, int inport);
@@ -95,8 +137,9 @@ class RoutingUnit
                              int inport,
                              PortDirection inport_dirn);
 
-    int outportComputeTDM(int vnet, NetDest net_dest,
-                          PortDirection inport_dirn, int inport);
+    int outportComputeTDM(RouteInfo route,
+                          int inport,
+                          PortDirection inport_dirn);
 
 
     //ANK modification starts
@@ -105,21 +148,39 @@ class RoutingUnit
       return m_outports_idx2dirn[port_num];
     }
 
-    int outport_dirn2id(PortDirection dirn){
-     return m_outports_dirn2idx[dirn];
-    }
+    int outport_dirn2id(PortDirection dirn);
 
     PortDirection inport_id2dirn(int port_num){
       return m_inports_idx2dirn[port_num];
     }
 
-    int inport_dirn2id(PortDirection dirn){
-      return m_inports_dirn2idx[dirn];
+    int inport_dirn2id(PortDirection dirn);
+
+    // Interned direction ids, for use in the per-flit path
+    int outport_dirn_id(int port_num){
+      return m_outports_idx2dirn_id[port_num];
+    }
+
+    int inport_dirn_id(int port_num){
+      return m_inports_idx2dirn_id[port_num];
+    }
+
+    int outport_dirn_id2idx(int dirn_id){
+      assert(dirn_id < m_outports_dirn_id2idx.size() &&
+             m_outports_dirn_id2idx[dirn_id] != -1);
+      return m_outports_dirn_id2idx[dirn_id];
+    }
+
+    bool is_local_inport(int port_num){
+      return m_inport_is_local[port_num];
+    }
+
+    bool is_local_outport(int port_num){
+      return m_outport_is_local[port_num];
     }
 
     std::vector<NetDest>& get_rtTable_ref() { return m_routing_table;}
     std::vector<int>& get_wtTable_ref() {return m_weight_table;}
-    std::vector<vector<int>>& get_wvTable_ref() {return m_wave_table;}
 
 
 
@@ -129,12 +190,31 @@ class RoutingUnit
     // Routing Table
     std::vector<NetDest> m_routing_table;
     std::vector<int> m_weight_table;
-    std::vector<vector<int>> m_wave_table; // move it here, cause networkinterface may access it
-    // Inport and Outport direction to idx maps
-    std::map<PortDirection, int> m_inports_dirn2idx;
-    std::map<int, PortDirection> m_inports_idx2dirn;
-    std::map<int, PortDirection> m_outports_idx2dirn;
-    std::map<PortDirection, int> m_outports_dirn2idx;
+    // Next hop cache: the minimum weight outports towards destination
+    // node d are m_cache_outports[m_cache_offset[d] .. m_cache_offset[d + 1])
+    // in increasing outport order (ordered vnets take the first one),
+    // and m_cache_mask[d] has their bits set.
+    std::vector<int> m_cache_outports;
+    std::vector<int> m_cache_offset;
+    std::vector<uint64_t> m_cache_mask;
+    // scratch candidate list reused by outportComputeTDM()
+    std::vector<int> m_candidates;
+    // TDM wave table, sized from the outports actually added:
+    // per-outport wave bitmask, and per-wave outport bitmask
+    std::vector<uint64_t> m_outport_wave_mask;
+    std::vector<uint64_t> m_wave_outport_mask;
+    uint64_t m_local_outport_mask;
+    // Inport and Outport direction tables, built in add*Direction():
+    // port idx -> direction name / interned direction id / is Local,
+    // and interned direction id -> port idx (-1 if no such port)
+    std::vector<PortDirection> m_inports_idx2dirn;
+    std::vector<PortDirection> m_outports_idx2dirn;
+    std::vector<int> m_inports_idx2dirn_id;
+    std::vector<int> m_outports_idx2dirn_id;
+    std::vector<int> m_inports_dirn_id2idx;
+    std::vector<int> m_outports_dirn_id2idx;
+    std::vector<bool> m_inport_is_local;
+    std::vector<bool> m_outport_is_local;
 };
 
 #endif // __MEM_RUBY_NETWORK_GARNET2_0_ROUTINGUNIT_HH__
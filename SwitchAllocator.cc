@@ -33,14 +33,18 @@
 
 #include "mem/ruby/network/garnet2.0/SwitchAllocator.hh"
 
+#include <cstring>
+
+#include "base/bitfield.hh"
 #include "debug/RubyNetwork.hh"
+#include "mem/ruby/network/garnet2.0/RoutingUnit.hh"
 //#include "mem/ruby/network/garnet2.0/GarnetNetwork.hh"
 // #include "mem/ruby/network/garnet2.0/InputUnit.hh"
 // #include "mem/ruby/network/garnet2.0/OutputUnit.hh"
 // #include "mem/ruby/network/garnet2.0/Router.hh"
 
 SwitchAllocator::SwitchAllocator(Router *router)
-    : Consumer(router)
+    : Consumer(router), m_side_buffer(RING_BUFFER_)
 {
     m_router = router;
     m_num_vcs = m_router->get_num_vcs();
@@ -55,6 +59,7 @@ SwitchAllocator::init()
 {
     m_input_unit = m_router->get_inputUnit_ref();
     m_output_unit = m_router->get_outputUnit_ref();
+    m_routing_unit = m_router->get_rtUnit_ptr();
 
     m_num_inports = m_router->get_num_inports();
     m_num_outports = m_router->get_num_outports();
@@ -62,26 +67,75 @@ SwitchAllocator::init()
     m_round_robin_invc.resize(m_num_inports);
     m_port_requests.resize(m_num_outports);
     m_vc_winners.resize(m_num_outports);
-    num_ports_req.resize(m_num_outports);
-    num_local_req.resize(m_num_outports);
+
+    // one request bit per inport
+    fatal_if(m_num_inports > MAX_MASK_PORTS_,
+             "Router %d has %d inports, at most %d are supported\n",
+             m_router->get_id(), m_num_inports, MAX_MASK_PORTS_);
+    m_local_inport_mask = 0;
+    for (int i = 0; i < m_num_inports; i++) {
+        if (m_routing_unit->is_local_inport(i))
+            m_local_inport_mask |= (uint64_t)1 << i;
+    }
+
+    m_side_buffer_depth = m_router->get_net_ptr()->getSideBufferDepth();
+    m_side_buffer.setMaxSize(m_side_buffer_depth);
+    m_side_absorbed = false;
+    m_side_absorbed_inports = 0;
+    m_side_outport = -1;
 
     inport_observed.resize(m_num_inports);
-    outport_ava.resize(m_num_outports);
+
+    // outport masks for the deflection permutation
+    fatal_if(m_num_outports > MAX_MASK_PORTS_,
+             "Router %d has %d outports, at most %d are supported\n",
+             m_router->get_id(), m_num_outports, MAX_MASK_PORTS_);
+    m_all_outport_mask = 0;
+    m_nonlocal_outport_mask = 0;
+    for (int i = 0; i < m_num_outports; i++) {
+        m_all_outport_mask |= (uint64_t)1 << i;
+        if (!m_routing_unit->is_local_outport(i))
+            m_nonlocal_outport_mask |= (uint64_t)1 << i;
+    }
+    m_outport_ava = m_all_outport_mask;
+    m_pn_inport_slot.assign(m_num_inports, -1);
+    m_pn_outport_slot.assign(m_num_outports, -1);
+    int num_slots = 0;
+    for (int i = 0; i < m_num_inports; i++) {
+        if (!m_routing_unit->is_local_inport(i) &&
+            num_slots < PERMUTATION_SLOTS_)
+            m_pn_inport_slot[i] = num_slots;
+        if (!m_routing_unit->is_local_inport(i))
+            num_slots++;
+    }
+    m_pn_enabled = (num_slots == PERMUTATION_SLOTS_ &&
+                    popCount(m_nonlocal_outport_mask) == PERMUTATION_SLOTS_);
+    num_slots = 0;
+    for (int i = 0; i < m_num_outports && m_pn_enabled; i++) {
+        if (!m_routing_unit->is_local_outport(i)) {
+            m_pn_outport_slot[i] = num_slots;
+            m_pn_slot_outport[num_slots++] = i;
+        }
+    }
+
+    m_uturn_outport_mask.assign(m_num_inports, 0);
+    for (int i = 0; i < m_num_inports; i++) {
+        for (int j = 0; j < m_num_outports; j++) {
+            if (m_routing_unit->outport_dirn_id(j) ==
+                m_routing_unit->inport_dirn_id(i))
+                m_uturn_outport_mask[i] |= (uint64_t)1 << j;
+        }
+    }
 
     for (int i = 0; i < m_num_inports; i++) {
         m_round_robin_invc[i] = 0;
     }
 
     for (int i = 0; i < m_num_outports; i++) {
-        m_port_requests[i].resize(m_num_inports);
         m_vc_winners[i].resize(m_num_inports);
-
         m_round_robin_inport[i] = 0;
-
-        for (int j = 0; j < m_num_inports; j++) {
-            m_port_requests[i][j] = false; // [outport][inport]
-        }
     }
+    clear_request_vector();
 }
 
 /*
@@ -110,6 +164,11 @@ SwitchAllocator::wakeup()
         verify_VCs_empty();
     }
 
+    if(routing_algo == DEFLECTION_ && m_side_buffer_depth > 0){
+        m_router->get_net_ptr()->sample_side_buffer_occupancy(
+            m_side_buffer.getSize());
+    }
+
 }
 
 /*
@@ -131,20 +190,11 @@ SwitchAllocator::arbitrate_inports()
         (RoutingAlgorithm) m_router->get_net_ptr()->getRoutingAlgorithm();
     //added for deflection, recalculate outport every cycle
     if(routing_algo == DEFLECTION_ || routing_algo == TDM_){
-        for (int i = 0; i < m_num_outports; i++) {
-            m_port_requests[i].resize(m_num_inports);
-            m_vc_winners[i].resize(m_num_inports);
-
-            m_round_robin_inport[i] = 0;
-
-            for (int j = 0; j < m_num_inports; j++) {
-                m_port_requests[i][j] = false; // [outport][inport]
-            }
-        }
+        clear_request_vector();
+        fill(m_round_robin_inport.begin(), m_round_robin_inport.end(), 0);
     }
     // Select a VC from each input in a round robin manner
     // Independent arbiter at each input port
-    PortDirection in_dirn;
 
     //cout<<"Before permutation "<<endl;
     for (int inport = 0; inport < m_num_inports; inport++) {
@@ -155,12 +205,9 @@ SwitchAllocator::arbitrate_inports()
 
             if (m_input_unit[inport]->need_stage(invc, SA_,
                 m_router->curCycle())) {
-                
-                in_dirn = m_router->router_inport_id2dirn(inport);
-                
                 flit *t_flit = m_input_unit[inport]->peekTopFlit(invc);
                 if(routing_algo == TDM_ || routing_algo == DEFLECTION_){
-                    //cout<<"flit id is "<<t_flit->getClkId()<<" inport id is "<<inport
+                    //cout<<"flit id is "<<t_flit->get_packet_id()<<" inport id is "<<inport
                     //                   <<" invc is "<<t_flit->get_vc()
                     //                  <<" prefer outport is "<<m_input_unit[inport]->get_outport(invc)<<endl;
                     m_permu_buf.push_back({t_flit, inport});
@@ -180,12 +227,12 @@ SwitchAllocator::arbitrate_inports()
 
                     if (routing_algo == DEFLECTION_) //TODO
                         assert(make_request);
-                    if (routing_algo == TDM_ && m_input_unit[inport]->get_direction() != "Local")
+                    if (routing_algo == TDM_ && !m_routing_unit->is_local_inport(inport))
                         assert(make_request);
 
                     if (make_request) {
                         m_input_arbiter_activity++;
-                        m_port_requests[outport][inport] = true;
+                        m_port_requests[outport] |= (uint64_t)1 << inport;
                         m_vc_winners[outport][inport]= invc;
 
                         // Update Round Robin pointer
@@ -207,34 +254,53 @@ SwitchAllocator::arbitrate_inports()
     //after permutation
     //cout<<"After permutation"<<endl;
     if(routing_algo == TDM_ || routing_algo == DEFLECTION_){
-        if(routing_algo == TDM_)
+        if(routing_algo == TDM_) {
             areLinksAvaliable();
+            countWaveBlocked();
+        } else {
+            m_outport_ava = m_all_outport_mask;
+        }
+        m_side_absorbed = false;
+        m_side_absorbed_inports = 0;
+        m_side_outport = -1;
+        int policy = m_router->get_net_ptr()->getDeflectionPolicy();
+        if(policy == BLESS_)
+            permutation_BLESS();
+        else if(policy == PERMUTATION_NETWORK_ && routing_algo == DEFLECTION_)
+            permutation_network();
         else
-            fill(outport_ava.begin(), outport_ava.end(), true);
-        permutation_CHIPPER();
-        //permutation_BLESS();
+            permutation_CHIPPER();
         //now flit is in SA stage
         for(int i = 0; i < m_permu_buf.size(); i++){
             flit *t_flit = m_permu_buf[i].first;
             int inport = m_permu_buf[i].second;
+            // taken by the side buffer
+            if ((m_side_absorbed_inports >> inport) & 1)
+                continue;
             int invc = t_flit->get_vc();
             int  outport = m_input_unit[inport]->get_outport(invc);
             int  outvc   = m_input_unit[inport]->get_outvc(invc);
+            // only a Local flit that has to wait can ask for the outport
+            // a side buffer flit was sent to, and it would win it
+            if (outport == m_side_outport) {
+                assert(m_routing_unit->is_local_inport(inport));
+                continue;
+            }
 
             bool make_request =
                 send_allowed(inport, invc, outport, outvc);
 
             if (routing_algo == DEFLECTION_) //TODO
                 assert(make_request);
-            if (routing_algo == TDM_ && m_input_unit[inport]->get_direction() != "Local")
+            if (routing_algo == TDM_ && !m_routing_unit->is_local_inport(inport))
                 assert(make_request);
 
-            //cout<<"flit id is "<<t_flit->getClkId()<<" inport id is "<<inport
+            //cout<<"flit id is "<<t_flit->get_packet_id()<<" inport id is "<<inport
             //                   <<" invc is "<<t_flit->get_vc()
             //                   <<" prefer outport is "<<m_input_unit[inport]->get_outport(invc)<<endl;
             if (make_request) {
                 m_input_arbiter_activity++;
-                m_port_requests[outport][inport] = true;
+                m_port_requests[outport] |= (uint64_t)1 << inport;
                 m_vc_winners[outport][inport]= invc;
 
                 // Update Round Robin pointer
@@ -246,66 +312,254 @@ SwitchAllocator::arbitrate_inports()
     }   
 }
 
+// Lower flit id first
 bool
-SwitchAllocator::compareFlitID(pair<flit*, int> a, pair<flit*, int> b){
-    return (a.first->get_id() <= b.first->get_id());
+SwitchAllocator::compareFlitID(const pair<flit*, int> &a,
+                               const pair<flit*, int> &b)
+{
+    return (a.first->get_id() < b.first->get_id());
 }
 
+// Oldest flit first; ties broken by source NI, then packet, then flit
+bool
+SwitchAllocator::compareFlitAge(const pair<flit*, int> &a,
+                                const pair<flit*, int> &b)
+{
+    flit *fa = a.first, *fb = b.first;
+    if (fa->get_enqueue_time() != fb->get_enqueue_time())
+        return (fa->get_enqueue_time() < fb->get_enqueue_time());
+    if (fa->get_src_ni() != fb->get_src_ni())
+        return (fa->get_src_ni() < fb->get_src_ni());
+    if (fa->get_packet_seq() != fb->get_packet_seq())
+        return (fa->get_packet_seq() < fb->get_packet_seq());
+    return (fa->get_id() < fb->get_id());
+}
+
+// Stable insertion sort, there is at most one flit per inport
+void
+SwitchAllocator::sortFlits(pair<flit*, int> *flits, int num_flits,
+                           bool (*less)(const pair<flit*, int> &,
+                                        const pair<flit*, int> &))
+{
+    for (int i = 1; i < num_flits; i++) {
+        pair<flit*, int> t_flit = flits[i];
+        int j = i;
+        for (; j > 0 && less(t_flit, flits[j - 1]); j--)
+            flits[j] = flits[j - 1];
+        flits[j] = t_flit;
+    }
+}
+
+// A random free non-local outport that is not a U-turn for inport,
+// the U-turn if nothing else is free, -1 if none is free at all
 int
-SwitchAllocator::getANonLocalOutport(PortDirection in_dirn){
-    int num_candidate = 0;
-    std::vector<int> candidateOutPorts;
-    candidateOutPorts.clear();
-    bool isUTurn = false;
-    int uTurnId = -1;
-    for(int i = 0; i < outport_ava.size(); i++){
-    	PortDirection out_dirn = m_output_unit[i]->get_direction();
-        if(out_dirn != "Local" && outport_ava[i] == true && out_dirn != in_dirn){
-            candidateOutPorts.push_back(i);
-            num_candidate++;        
-        }else if(out_dirn != "Local" && outport_ava[i] == true && out_dirn == in_dirn){
-        	isUTurn = true;
-        	uTurnId = i;
-        }
+SwitchAllocator::getANonLocalOutport(int inport){
+    uint64_t candidates = m_outport_ava & m_nonlocal_outport_mask;
+    uint64_t others = candidates & ~m_uturn_outport_mask[inport];
+
+    if(others){
+        int candidate = rand() % popCount(others);
+        for(; candidate > 0; candidate--)
+            others &= others - 1;
+        return findLsbSet(others);
     }
 
-    int candidate = 0;
-    if(num_candidate > 0){
-    	candidate = rand() % num_candidate;
-    	return candidateOutPorts.at(candidate);
+    //  only uturn link is avaliable
+    if(candidates)
+        return findMsbSet(candidates);
+
+    return -1;
+}
+
+// Preferred outport if it is free and not a U-turn, else the side
+// buffer (if may_absorb), else deflect to any free non-local outport
+void
+SwitchAllocator::placeNonLocalFlit(int inport, int invc, bool may_absorb)
+{
+    int prefer_outport = m_input_unit[inport]->get_outport(invc);
+    uint64_t prefer_bit = (uint64_t)1 << prefer_outport;
+    bool isUTurn = m_uturn_outport_mask[inport] & prefer_bit;
+
+    if((m_outport_ava & prefer_bit) && !isUTurn){ //u turn has least priority
+        m_outport_ava &= ~prefer_bit;
+        m_input_unit[inport]->set_flag(true);
+        m_input_unit[inport]->grant_outport(invc, prefer_outport);
+    }else if(!may_absorb || !absorbSideFlit(inport, invc)){
+        int rand_outport = getANonLocalOutport(inport);
+        assert(rand_outport != -1 && !m_routing_unit->is_local_outport(rand_outport));
+        m_outport_ava &= ~((uint64_t)1 << rand_outport);
+        m_input_unit[inport]->set_flag(true);
+        m_input_unit[inport]->grant_outport(invc, rand_outport);
     }
+}
 
-//  only uturn link is avaliable
-    if(isUTurn){
-    	assert(uTurnId != -1);
-    	return uTurnId;
+// Local flits may take a non-preferred or no outport: when nothing is
+// free they wait at the Local inport
+void
+SwitchAllocator::placeLocalFlit(int inport, int invc)
+{
+    assert(m_routing_unit->is_local_inport(inport));
+    int prefer_outport = m_input_unit[inport]->get_outport(invc);
+    uint64_t prefer_bit = (uint64_t)1 << prefer_outport;
+
+    if(m_outport_ava & prefer_bit){
+        m_outport_ava &= ~prefer_bit;
+        m_input_unit[inport]->set_flag(true);
+        m_input_unit[inport]->grant_outport(invc, prefer_outport);
+    }else{
+        int rand_outport = getANonLocalOutport(inport);
+        if(rand_outport == -1){
+            m_input_unit[inport]->set_flag(false);
+            m_input_unit[inport]->grant_outport(invc, prefer_outport);
+        }else{
+            m_outport_ava &= ~((uint64_t)1 << rand_outport);
+            m_input_unit[inport]->set_flag(true);
+            m_input_unit[inport]->grant_outport(invc, rand_outport);
+        }
     }
+}
 
-    return -1;
+// Take the flit at inport, invc into the side buffer instead of
+// deflecting it. Its input VC is freed as if it had left.
+bool
+SwitchAllocator::absorbSideFlit(int inport, int invc)
+{
+    RoutingAlgorithm routing_algo =
+        (RoutingAlgorithm) m_router->get_net_ptr()->getRoutingAlgorithm();
+    if (routing_algo != DEFLECTION_ || m_side_buffer_depth == 0 ||
+        m_side_absorbed || m_side_buffer.isFull())
+        return false;
+
+    Cycles curTime = m_router->curCycle();
+    // keep the route computed on arrival, so that reinjection does not
+    // have to look it up again
+    int prefer_outport = m_input_unit[inport]->get_outport(invc);
+    flit *t_flit = m_input_unit[inport]->getTopFlit(invc);
+    t_flit->set_outport(prefer_outport);
+    m_input_unit[inport]->set_vc_idle(invc, curTime);
+    m_input_unit[inport]->increment_credit(invc, true, curTime);
+    m_input_unit[inport]->set_flag(false);
+
+    m_side_buffer.insert(t_flit);
+    m_side_absorbed = true;
+    m_side_absorbed_inports |= (uint64_t)1 << inport;
+    m_router->get_net_ptr()->increment_side_buffer_absorbed();
+
+    DPRINTF(RubyNetwork, "SwitchAllocator at Router %d moved flit %s "
+            "from inport %s to the side buffer at time: %lld\n",
+            m_router->get_id(), *t_flit,
+            m_router->getPortDirectionName(
+                m_input_unit[inport]->get_direction()),
+            curTime);
+    return true;
+}
+
+// Send the oldest side buffer flit to its preferred outport if that is
+// still free after the flits that arrived this cycle. When the buffer is
+// full it leaves through any free link instead, so it cannot clog.
+// Called before Local flits are placed.
+void
+SwitchAllocator::reinjectSideFlit()
+{
+    if (m_side_buffer.isEmpty())
+        return;
+
+    // it needs a crossbar input that carries no flit this cycle
+    uint64_t busy_inports = 0;
+    for (int i = 0; i < m_permu_buf.size(); i++)
+        busy_inports |= (uint64_t)1 << m_permu_buf[i].second;
+    busy_inports &= ~m_side_absorbed_inports;
+    int slot = -1;
+    for (int i = 0; i < m_num_inports; i++) {
+        if (!((busy_inports >> i) & 1)) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot == -1)
+        return;
+
+    flit *t_flit = m_side_buffer.peekTopFlit();
+    int vnet = t_flit->get_vnet();
+    int outport = t_flit->get_outport();    // preferred, set on absorption
+    bool deflected = false;
+    if (!((m_outport_ava >> outport) & 1)) {
+        uint64_t free_links = m_outport_ava & m_nonlocal_outport_mask;
+        if (!m_side_buffer.isFull() || free_links == 0)
+            return;
+        outport = findLsbSet(free_links);
+        deflected = true;
+    }
+
+    m_side_buffer.getTopFlit();
+    m_outport_ava &= ~((uint64_t)1 << outport);
+    m_side_outport = outport;
+
+    Cycles curTime = m_router->curCycle();
+    int outvc = m_output_unit[outport]->select_free_vc(vnet,
+        t_flit->get_vc(), m_input_unit[slot]->get_direction(),
+        m_output_unit[outport]->get_direction(), t_flit->get_route());
+    t_flit->set_outport(outport);
+    t_flit->set_vc(outvc);
+    m_output_unit[outport]->decrement_credit(outvc);
+    t_flit->advance_stage(ST_, curTime);
+    m_router->grant_switch(slot, t_flit);
+    m_output_arbiter_activity++;
+    m_router->get_net_ptr()->increment_side_buffer_reinjected(deflected);
+
+    DPRINTF(RubyNetwork, "SwitchAllocator at Router %d sent flit %s "
+            "from the side buffer to outport %s at time: %lld\n",
+            m_router->get_id(), *t_flit,
+            m_router->getPortDirectionName(
+                m_output_unit[outport]->get_direction()),
+            curTime);
+}
+
+uint32_t
+SwitchAllocator::functionalWrite(Packet *pkt)
+{
+    return m_side_buffer.functionalWrite(pkt);
 }
 
 void
 SwitchAllocator::areLinksAvaliable(){
-    assert(outport_ava.size() == m_num_outports);
-    fill(outport_ava.begin(), outport_ava.end(), true);
-    for(int i = 0; i < outport_ava.size(); i++){
-        if(!m_router->isLinkAvaliable(i))
-            outport_ava[i] = false;
+    m_outport_ava = m_router->getNextWaveOutports() & m_all_outport_mask;
+}
+
+// TDM: count the flits whose productive outport is closed in the wave
+// checked this cycle; they get deflected, or wait if they are Local.
+// Called right after areLinksAvaliable().
+void
+SwitchAllocator::countWaveBlocked()
+{
+    int wave = (int)m_router->getNextWave();
+    for (int i = 0; i < m_permu_buf.size(); i++) {
+        flit *t_flit = m_permu_buf[i].first;
+        int inport = m_permu_buf[i].second;
+        int outport = m_input_unit[inport]->get_outport(t_flit->get_vc());
+        if ((m_outport_ava >> outport) & 1)
+            continue;
+        m_output_unit[outport]->increment_wave_blocked(wave);
+        m_router->get_net_ptr()->increment_wave_blocked();
     }
 }
 
-void //TODO
+// CHIPPER: gold flits first (by flit id), then the other flits that
+// arrived from neighbours, then Local flits. At most one flit per inport
+// competes, so the flit lists live on the stack.
+void
 SwitchAllocator::permutation_CHIPPER()
 {
-    std::vector<pair<flit*, int>> gold_flits;
-    std::vector<pair<flit*, int>> non_gold_flits;
-    std::vector<pair<flit*, int>> local_flits;
+    pair<flit*, int> gold_flits[MAX_MASK_PORTS_];
+    pair<flit*, int> non_gold_flits[MAX_MASK_PORTS_];
+    pair<flit*, int> local_flits[MAX_MASK_PORTS_];
+    int num_gold = 0, num_non_gold = 0, num_local = 0;
+    assert(m_permu_buf.size() <= MAX_MASK_PORTS_);
 
-    //print flit type
+    //split flit type
     for(int i = 0; i < m_permu_buf.size(); i++){
         int inport = m_permu_buf[i].second;
         flit *t_flit = m_permu_buf[i].first;
-        //cout<<"SA, is gold state "<<t_flit->is_gold_state()<<"inport id "<<inport<<m_input_unit[inport]->get_direction()<<endl;
         DPRINTF(RubyNetwork, "PERMUTATION SwitchAllocator at Router %d "
                                      " at inport %d to flit %s at "
                                      "time: %lld\n",
@@ -314,133 +568,64 @@ SwitchAllocator::permutation_CHIPPER()
                             m_input_unit[inport]->get_direction()),
                             *t_flit,
                         m_router->curCycle());
-    }
-
-    //split flit type  
-    for(int i = 0; i < m_permu_buf.size(); i++){
-        int inport = m_permu_buf[i].second;
-        flit *t_flit = m_permu_buf[i].first;
         if(t_flit->is_gold_state())
-            gold_flits.push_back(m_permu_buf[i]);
-        else if(m_input_unit[inport]->get_direction() == "Local")
-            local_flits.push_back(m_permu_buf[i]);
+            gold_flits[num_gold++] = m_permu_buf[i];
+        else if(m_routing_unit->is_local_inport(inport))
+            local_flits[num_local++] = m_permu_buf[i];
         else
-            non_gold_flits.push_back(m_permu_buf[i]);
+            non_gold_flits[num_non_gold++] = m_permu_buf[i];
     }
-    
-    //sort gold state in decend order
-    sort(gold_flits.begin(), gold_flits.end(), std::bind(&SwitchAllocator::compareFlitID, this, std::placeholders::_1, std::placeholders::_2));
-    bool isUTurn = false;
-    //alloc gold flit 
-    for(int i = 0; i < gold_flits.size(); i++){
+
+    sortFlits(gold_flits, num_gold, compareFlitID);
+
+    //alloc gold flit
+    for(int i = 0; i < num_gold; i++){
         int inport = gold_flits[i].second;
-        PortDirection in_dirn = m_input_unit[inport]->get_direction();
+        int invc = gold_flits[i].first->get_vc();
         //one possible case for local flit to be gold
         //Local to Local
         //in this case, release them only if the local outport is avaliable, otherwise stall at local
-        int invc = gold_flits[i].first->get_vc();
-        int prefer_outport = m_input_unit[inport]->get_outport(invc);
-        int rand_outport = -1;
-        if(m_output_unit[prefer_outport]->get_direction() == in_dirn){
-        	isUTurn = true;
-        }else{
-        	isUTurn = false;
-        }
-
-        //todo LOCAL TO LOCAL as a special case
-        if(in_dirn == "Local"){
-            assert(m_output_unit[prefer_outport]->get_direction() == "Local");
+        if(m_routing_unit->is_local_inport(inport)){
+            int prefer_outport = m_input_unit[inport]->get_outport(invc);
+            assert(m_routing_unit->is_local_outport(prefer_outport));
             m_input_unit[inport]->grant_outport(invc, prefer_outport);
             m_input_unit[inport]->set_flag(true);
         }else{
-            if(outport_ava[prefer_outport] && !isUTurn){ //u turn has least priority
-                outport_ava[prefer_outport] = false;
-                m_input_unit[inport]->set_flag(true);
-                m_input_unit[inport]->grant_outport(invc, prefer_outport);
-            }else{
-                rand_outport = getANonLocalOutport(in_dirn);
-                assert(rand_outport != -1 && m_output_unit[rand_outport]->get_direction() != "Local");
-                outport_ava[rand_outport] = false;
-                m_input_unit[inport]->set_flag(true);
-                m_input_unit[inport]->grant_outport(invc, rand_outport);                
-            	//cout<<"SA: Router "<<m_router->get_id()<<" inport "<<inport<<", flit "
-            	//	<<gold_flits[i].first->get_type()<<", prefer "<<prefer_outport<<", deflect to "<<rand_outport<<endl;
-            }
+            placeNonLocalFlit(inport, invc, false);
         }
     }
 
     //alloc non-gold-flit
-    for(int i = 0; i < non_gold_flits.size(); i++){
+    for(int i = 0; i < num_non_gold; i++){
         int inport = non_gold_flits[i].second;
-        assert(m_input_unit[inport]->get_direction() != "Local");
-        PortDirection in_dirn = m_input_unit[inport]->get_direction();
-        int invc = non_gold_flits[i].first->get_vc();
-        int prefer_outport = m_input_unit[inport]->get_outport(invc);
-        int rand_outport = -1;
-
-        if(m_output_unit[prefer_outport]->get_direction() == in_dirn){
-        	isUTurn = true;
-        }else{
-        	isUTurn = false;
-        }
-
-        if(outport_ava[prefer_outport] && !isUTurn){
-            outport_ava[prefer_outport] = false;
-            m_input_unit[inport]->set_flag(true);
-            m_input_unit[inport]->grant_outport(invc, prefer_outport);
-        }else{
-            rand_outport = getANonLocalOutport(in_dirn);
-            assert(rand_outport != -1 && m_output_unit[rand_outport]->get_direction() != "Local");
-            outport_ava[rand_outport] = false;
-            m_input_unit[inport]->set_flag(true);
-            m_input_unit[inport]->grant_outport(invc, rand_outport);
-            //cout<<"SA: Router "<<m_router->get_id()<<" inport "<<inport<<", flit "
-            //		<<non_gold_flits[i].first->get_type()<<", prefer "<<prefer_outport<<", deflect to "<<rand_outport<<endl;
-            
-        }
+        assert(!m_routing_unit->is_local_inport(inport));
+        placeNonLocalFlit(inport, non_gold_flits[i].first->get_vc(), true);
     }
 
+    reinjectSideFlit();
+
     //alloc local flit
     //allow non-avaliable outport
-    for(int i = 0; i < local_flits.size(); i++){
-        int inport = local_flits[i].second;
-        assert(m_input_unit[inport]->get_direction() == "Local");
-        int invc = local_flits[i].first->get_vc();
-        int prefer_outport = m_input_unit[inport]->get_outport(invc);
-        int rand_outport = -1;
-        if(outport_ava[prefer_outport]){
-            outport_ava[prefer_outport] = false;
-            m_input_unit[inport]->set_flag(true);
-            m_input_unit[inport]->grant_outport(invc, prefer_outport);
-        }else{
-            rand_outport = getANonLocalOutport(m_input_unit[inport]->get_direction());
-            if(rand_outport == -1){
-                m_input_unit[inport]->set_flag(false);
-                m_input_unit[inport]->grant_outport(invc, prefer_outport);
-            }else{
-                outport_ava[rand_outport] = false;
-                m_input_unit[inport]->set_flag(true);
-                m_input_unit[inport]->grant_outport(invc, rand_outport);
-                //cout<<"SA: Router "<<m_router->get_id()<<" inport "<<inport<<", flit "
-            	//	<<local_flits[i].first->get_type()<<", prefer "<<prefer_outport<<", deflect to "<<rand_outport<<endl;
- 
-            }
-        }
+    for(int i = 0; i < num_local; i++){
+        placeLocalFlit(local_flits[i].second, local_flits[i].first->get_vc());
     }
 }
-//TODO:modify uturn policy for bless future
-/*
+
+// BLESS: every non-local flit is ranked oldest first, the oldest flit
+// gets its preferred outport, younger ones are deflected when it is taken.
+// U-turns have the least priority, as in CHIPPER.
 void
 SwitchAllocator::permutation_BLESS()
 {
-    std::vector<pair<flit*, int>> order_flits;
-    std::vector<pair<flit*, int>> local_flits;
+    pair<flit*, int> order_flits[MAX_MASK_PORTS_];
+    pair<flit*, int> local_flits[MAX_MASK_PORTS_];
+    int num_order = 0, num_local = 0;
+    assert(m_permu_buf.size() <= MAX_MASK_PORTS_);
 
-    //print flit type
+    //split flit type
     for(int i = 0; i < m_permu_buf.size(); i++){
         int inport = m_permu_buf[i].second;
         flit *t_flit = m_permu_buf[i].first;
-        //cout<<"SA, is gold state "<<t_flit->is_gold_state()<<"inport id "<<inport<<m_input_unit[inport]->get_direction()<<endl;
         DPRINTF(RubyNetwork, "PERMUTATION SwitchAllocator at Router %d "
                                      " at inport %d to flit %s at "
                                      "time: %lld\n",
@@ -449,79 +634,185 @@ SwitchAllocator::permutation_BLESS()
                             m_input_unit[inport]->get_direction()),
                             *t_flit,
                         m_router->curCycle());
-    }
-
-    //split flit type  
-    for(int i = 0; i < m_permu_buf.size(); i++){
-        int inport = m_permu_buf[i].second;
-        //flit *t_flit = m_permu_buf[i].first;
-        
-        if(m_input_unit[inport]->get_direction() == "Local")
-            local_flits.push_back(m_permu_buf[i]);
+        if(m_routing_unit->is_local_inport(inport))
+            local_flits[num_local++] = m_permu_buf[i];
         else
-            order_flits.push_back(m_permu_buf[i]);
+            order_flits[num_order++] = m_permu_buf[i];
     }
-    
-    //sort non-local state in decend order
-    sort(order_flits.begin(), order_flits.end(), std::bind(&SwitchAllocator::compareFlitID, this, std::placeholders::_1, std::placeholders::_2));
 
-    //alloc non-local flit 
-    for(int i = 0; i < order_flits.size(); i++){
-        int inport = order_flits[i].second;
+    //sort non-local flits, oldest first
+    sortFlits(order_flits, num_order, compareFlitAge);
 
-        //one possible case for local flit to be gold
-        //Local to Local
-        //in this case, release them only if the local outport is avaliable, otherwise stall at local
-        int invc = order_flits[i].first->get_vc();
-        int prefer_outport = m_input_unit[inport]->get_outport(invc);
-        int rand_outport = -1;
-                
-        if(outport_ava[prefer_outport]){
-            outport_ava[prefer_outport] = false;
-            m_input_unit[inport]->set_flag(true);
-            m_input_unit[inport]->grant_outport(invc, prefer_outport);
-        }else{
-            rand_outport = getANonLocalOutport();
-            assert(rand_outport != -1 && m_output_unit[rand_outport]->get_direction() != "Local");
-            outport_ava[rand_outport] = false;
-            m_input_unit[inport]->set_flag(true);
-            m_input_unit[inport]->grant_outport(invc, rand_outport);                
-                //cout<<"SA: Router "<<m_router->get_id()<<" inport "<<inport<<", flit "
-                //  <<gold_flits[i].first->get_type()<<", prefer "<<prefer_outport<<", deflect to "<<rand_outport<<endl;
-        }
+    //alloc non-local flit
+    for(int i = 0; i < num_order; i++){
+        placeNonLocalFlit(order_flits[i].second,
+                          order_flits[i].first->get_vc(), true);
     }
 
+    reinjectSideFlit();
+
     //alloc local flit
     //allow non-avaliable outport
-    for(int i = 0; i < local_flits.size(); i++){
-        int inport = local_flits[i].second;
-        assert(m_input_unit[inport]->get_direction() == "Local");
-        int invc = local_flits[i].first->get_vc();
-        int prefer_outport = m_input_unit[inport]->get_outport(invc);
-        int rand_outport = -1;
-        if(outport_ava[prefer_outport]){
-            outport_ava[prefer_outport] = false;
-            m_input_unit[inport]->set_flag(true);
-            m_input_unit[inport]->grant_outport(invc, prefer_outport);
-        }else{
-            rand_outport = getANonLocalOutport();
-            if(rand_outport == -1){
-                m_input_unit[inport]->set_flag(false);
+    for(int i = 0; i < num_local; i++){
+        placeLocalFlit(local_flits[i].second, local_flits[i].first->get_vc());
+    }
+}
+
+// Gold flits first, then the older flit
+bool
+SwitchAllocator::pnHigherPriority(int a, int b)
+{
+    if (m_pn_flit[a]->is_gold_state() != m_pn_flit[b]->is_gold_state())
+        return m_pn_flit[a]->is_gold_state();
+    return compareFlitAge({m_pn_flit[a], m_pn_inport[a]},
+                          {m_pn_flit[b], m_pn_inport[b]});
+}
+
+// One 2x2 arbiter block. in[] and out[] hold flit entries (-1: none).
+// Output 0/1 of a stage 0 block feeds stage 1 block 0/1, and stage 1
+// block k drives output slots 2k and 2k + 1. The higher priority flit
+// takes the output on the way to its wanted slot, the other flit gets
+// the remaining output and is deflected if it wanted the same one.
+void
+SwitchAllocator::pnArbiterBlock(int stage, int block, const int in[2],
+                                int out[2])
+{
+    int first = in[0], second = in[1];
+    if (first == -1 || (second != -1 && pnHigherPriority(second, first)))
+        std::swap(first, second);
+    out[0] = out[1] = -1;
+    if (first == -1)
+        return;
+
+    // output wanted by a flit at this block, -1 if any will do
+    int want[2];
+    for (int i = 0; i < 2; i++) {
+        int entry = (i == 0) ? first : second;
+        want[i] = -1;
+        if (entry == -1 || m_pn_want[entry] == -1)
+            continue;
+        if (stage == 0)
+            want[i] = m_pn_want[entry] / 2;
+        else if (m_pn_want[entry] / 2 == block)
+            want[i] = m_pn_want[entry] % 2;
+        // else already sent to the wrong half in stage 0
+    }
+
+    int first_out = want[0];
+    if (first_out == -1)
+        first_out = (want[1] == -1) ? 0 : 1 - want[1];
+    out[first_out] = first;
+    if (second == -1)
+        return;
+    out[1 - first_out] = second;
+    if (want[1] == first_out)
+        m_router->get_net_ptr()->increment_permutation_deflections(stage);
+}
+
+// CHIPPER permutation network: a flit that wants a Local outport is
+// ejected first if that outport is free, the other non-local flits go
+// through two stages of arbiter blocks, then the side buffer and Local
+// flits take what is left, as in permutation_CHIPPER.
+void
+SwitchAllocator::permutation_network()
+{
+    if (!m_pn_enabled) {
+        permutation_CHIPPER();
+        return;
+    }
+
+    pair<flit*, int> local_flits[MAX_MASK_PORTS_];
+    int num_local = 0;
+    assert(m_permu_buf.size() <= MAX_MASK_PORTS_);
+    for (int s = 0; s < PERMUTATION_SLOTS_; s++)
+        m_pn_flit[s] = NULL;
+
+    for (int i = 0; i < m_permu_buf.size(); i++) {
+        flit *t_flit = m_permu_buf[i].first;
+        int inport = m_permu_buf[i].second;
+        int invc = t_flit->get_vc();
+        if (m_routing_unit->is_local_inport(inport)) {
+            if (t_flit->is_gold_state()) {
+                // Local to Local, as in permutation_CHIPPER
+                int prefer_outport = m_input_unit[inport]->get_outport(invc);
+                assert(m_routing_unit->is_local_outport(prefer_outport));
                 m_input_unit[inport]->grant_outport(invc, prefer_outport);
-            }else{
-                outport_ava[rand_outport] = false;
                 m_input_unit[inport]->set_flag(true);
-                assert(m_output_unit[rand_outport]->get_direction() != "Local");
-                m_input_unit[inport]->grant_outport(invc, rand_outport);
-                //cout<<"SA: Router "<<m_router->get_id()<<" inport "<<inport<<", flit "
-                //  <<local_flits[i].first->get_type()<<", prefer "<<prefer_outport<<", deflect to "<<rand_outport<<endl;
- 
+            } else {
+                local_flits[num_local++] = m_permu_buf[i];
             }
+            continue;
+        }
+        int slot = m_pn_inport_slot[inport];
+        m_pn_flit[slot] = t_flit;
+        m_pn_inport[slot] = inport;
+    }
+
+    // ejection, highest priority flit first
+    int order[PERMUTATION_SLOTS_];
+    int num_flits = 0;
+    for (int s = 0; s < PERMUTATION_SLOTS_; s++) {
+        if (m_pn_flit[s] == NULL)
+            continue;
+        int j = num_flits++;
+        for (; j > 0 && pnHigherPriority(s, order[j - 1]); j--)
+            order[j] = order[j - 1];
+        order[j] = s;
+    }
+    for (int i = 0; i < num_flits; i++) {
+        int s = order[i];
+        int invc = m_pn_flit[s]->get_vc();
+        int prefer_outport = m_input_unit[m_pn_inport[s]]->get_outport(invc);
+        uint64_t prefer_bit = (uint64_t)1 << prefer_outport;
+        m_pn_want[s] = m_pn_outport_slot[prefer_outport];
+        if (!m_routing_unit->is_local_outport(prefer_outport))
+            continue;
+        if (m_outport_ava & prefer_bit) {
+            m_outport_ava &= ~prefer_bit;
+            m_input_unit[m_pn_inport[s]]->set_flag(true);
+            m_input_unit[m_pn_inport[s]]->grant_outport(invc, prefer_outport);
+            m_pn_flit[s] = NULL;
+        }
+    }
+
+    // two stages of arbiter blocks
+    int stage_in[PERMUTATION_SLOTS_], stage_out[PERMUTATION_SLOTS_];
+    for (int s = 0; s < PERMUTATION_SLOTS_; s++) {
+        stage_in[s] = (m_pn_flit[s] == NULL) ? -1 : s;
+        if (stage_in[s] != -1)
+            m_router->get_net_ptr()->increment_permutation_flits();
+    }
+    for (int stage = 0; stage < 2; stage++) {
+        for (int block = 0; block < 2; block++)
+            pnArbiterBlock(stage, block, &stage_in[2 * block],
+                           &stage_out[2 * block]);
+        if (stage == 0) {
+            // output k of block b feeds input b of stage 1 block k
+            stage_in[0] = stage_out[0];
+            stage_in[1] = stage_out[2];
+            stage_in[2] = stage_out[1];
+            stage_in[3] = stage_out[3];
         }
     }
 
+    for (int s = 0; s < PERMUTATION_SLOTS_; s++) {
+        int entry = stage_out[s];
+        if (entry == -1)
+            continue;
+        int outport = m_pn_slot_outport[s];
+        int inport = m_pn_inport[entry];
+        m_outport_ava &= ~((uint64_t)1 << outport);
+        m_input_unit[inport]->set_flag(true);
+        m_input_unit[inport]->grant_outport(m_pn_flit[entry]->get_vc(),
+                                            outport);
+    }
+
+    reinjectSideFlit();
+
+    for (int i = 0; i < num_local; i++) {
+        placeLocalFlit(local_flits[i].second, local_flits[i].first->get_vc());
+    }
 }
-*/
 
 /*
  * SA-II (or SA-o) loops through all output ports,
@@ -544,229 +835,116 @@ SwitchAllocator::arbitrate_outports()
     // Again do round robin arbitration on these requests
     // Independent arbiter at each output port
     
-    //int num_ports_req[6]={0};
-    
-    for (int i = 0; i < m_num_outports; i++) {
-        num_ports_req[i] = 0;
-    }
-    //count number of requirement from local inport to outport i
-    for (int i = 0; i < m_num_outports; i++){
-        num_local_req[i] = 0;
-    }
-
     RoutingAlgorithm routing_algo =
         (RoutingAlgorithm) m_router->get_net_ptr()->getRoutingAlgorithm();
+    bool bufferless = (routing_algo == DEFLECTION_ || routing_algo == TDM_);
 
-    /*Assert check logic begins to check for multi outport assignment*/
-    
-    if(routing_algo == DEFLECTION_ || routing_algo == TDM_){
-      bool is_prev_local;
-    
-        for (int outport = 0; outport < m_num_outports; outport++) {
-            
-            is_prev_local = false;
-
-            for (int inport_iter = 0; inport_iter < m_num_inports;
-                     inport_iter++) {
-
-                // inport has a request this cycle for outport
-                if (m_port_requests[outport][inport_iter]) {
-                
-    
-                    ++num_ports_req[outport];   
-                    if(num_ports_req[outport] >= 2){
-                        //std::cout <<"\n\nis pre local" <<is_prev_local << "is local" << m_router->router_inport_id2dirn(inport_iter)<<endl;
-                        //std::cout <<"router id is "<<m_router->get_id()<<endl;
-                        //std::cout <<"current outport id is "<< outport << "outport direction is "<< m_router->router_outport_id2dirn(outport)<<endl;
-                        assert(is_prev_local || (m_router->router_inport_id2dirn(inport_iter) == "Local")); //similar problem here
-                        if(m_router->router_inport_id2dirn(inport_iter) == "Local")
-                            num_local_req[outport]++;
-                    }
-                    else{
-                        if(m_router->router_inport_id2dirn(inport_iter) == "Local"){
-                            is_prev_local = true;
-                            num_local_req[outport]++;                   
-                        }
-                    }
-                }
-            }
-        }
-    }
     //initialize, inport observed situation
     fill(inport_observed.begin(), inport_observed.end(), false);
-    /*Assertion check logic ends for Multi outport assignment*/
 
     for (int outport = 0; outport < m_num_outports; outport++) {
-        int inport = m_round_robin_inport[outport];
-
-        for (int inport_iter = 0; inport_iter < m_num_inports;
-                 inport_iter++) {
-            // inport has a request this cycle for outport
-            if (m_port_requests[outport][inport]) {
-
-                if(routing_algo == DEFLECTION_ || routing_algo == TDM_){// release non-local flits first
-
-                    if(num_ports_req[outport] >= 2){
-                        //all outport request may come from local
-                        //apply num request from local to prevent deadlock
-                        assert(num_local_req[outport] <= num_ports_req[outport]);
-                        if(num_local_req[outport] < num_ports_req[outport]){
-                            if(m_router->router_inport_id2dirn(inport) == "Local"){
-                                //std::cout<<"\nSA logic Local check inport value is"<<inport <<endl;
-                                inport++; // if this inport is Local, skip
-                                if (inport >= m_num_inports)
-                                    inport = 0;
-
-                                continue;
-                            }
-                        }
-                    }
-                
-                }
-
-                //added for deflection
-                //every cycle one inport only can release one flit
-                //this only happened, when flits from local
-                /*
-                if(routing_algo == DEFLECTION_ || routing_algo == TDM_){
-                    if(inport_observed[inport] == true){
-                        assert(m_input_unit[inport]->get_direction() == "Local");
-                        inport++; 
-                        if (inport >= m_num_inports)
-                            inport = 0;
-                        continue;
-                    }
-                }
-                */
-
-                // grant this outport to this inport
-                int invc = m_vc_winners[outport][inport];
-
-                int outvc = m_input_unit[inport]->get_outvc(invc);
-                if (outvc == -1) {
-                    // VC Allocation - select any free VC from outport
-                    outvc = vc_allocate(outport, inport, invc);
-                }
+        uint64_t requests = m_port_requests[outport];
+        if (requests == 0)
+            continue;
+
+        if (bufferless) {
+            // Only flits injected from Local may share an outport:
+            // when several inports ask for it, either the first of them
+            // is Local or all the others are
+            uint64_t first = requests & (~requests + 1);
+            assert((first & m_local_inport_mask) ||
+                   !(requests & ~first & ~m_local_inport_mask));
+
+            // release non-local flits first,
+            // unless all requests come from Local
+            if (requests & ~m_local_inport_mask)
+                requests &= ~m_local_inport_mask;
+        }
 
-                if(routing_algo == DEFLECTION_ || routing_algo == TDM_)
-                    assert(invc == outvc);
+        int inport = roundRobinPick(requests, m_round_robin_inport[outport]);
 
-                // remove flit from Input VC
-                flit *t_flit = m_input_unit[inport]->getTopFlit(invc);
+        // grant this outport to this inport
+        int invc = m_vc_winners[outport][inport];
 
-                //make inport as observed
-                inport_observed[inport] = true;
-                //std::cout<<"\nSA select inport "<<inport<<"direction is "<< m_router->router_inport_id2dirn(inport) <<"flit from "<<invc<<endl;
-                //std::cout<<"SA correspoding outport is "<<outport<<endl; 
-                DPRINTF(RubyNetwork, "SwitchAllocator at Router %d "
-                                     "granted outvc %d at outport %d "
-                                     "to invc %d at inport %d to flit %s at "
-                                     "time: %lld\n",
-                        m_router->get_id(), outvc,
-                        m_router->getPortDirectionName(
-                            m_output_unit[outport]->get_direction()),
-                        invc,
-                        m_router->getPortDirectionName(
-                            m_input_unit[inport]->get_direction()),
-                            *t_flit,
-                        m_router->curCycle());
+        int outvc = m_input_unit[inport]->get_outvc(invc);
+        if (outvc == -1) {
+            // VC Allocation - select any free VC from outport
+            outvc = vc_allocate(outport, inport, invc);
+        }
 
+        if(routing_algo == DEFLECTION_ || routing_algo == TDM_)
+            assert(invc == outvc);
 
-                // Update outport field in the flit since this is
-                // used by CrossbarSwitch code to send it out of
-                // correct outport.
-                // Note: post route compute in InputUnit,
-                // outport is updated in VC, but not in flit
-                t_flit->set_outport(outport);
-
-                // set outvc (i.e., invc for next hop) in flit
-                // (This was updated in VC by vc_allocate, but not in flit)
-                t_flit->set_vc(outvc);
-
-                // decrement credit in outvc
-                m_output_unit[outport]->decrement_credit(outvc);
-                //std::cout<<"SA, at router "<< m_router->get_id() << " selected outport is "<<outport<< "current credit is "<<m_output_unit[outport]->get_credit_count(outvc)<<"out vc is "<<outvc<<endl;
-
-                //check next router id
-
-                // flit ready for Switch Traversal
-                t_flit->advance_stage(ST_, m_router->curCycle());
-                m_router->grant_switch(inport, t_flit);
-                m_output_arbiter_activity++;
-
-                if(routing_algo == DEFLECTION_ || routing_algo == TDM_){
-                    //input VC should always be empty, because it only handles 1 flit each time
-                    if(m_input_unit[inport]->get_direction() != "Local"){
-                        assert(!(m_input_unit[inport]->isReady(invc,
-                                m_router->curCycle())));
-                        m_input_unit[inport]->set_vc_idle(invc,
-                                m_router->curCycle());
-                        m_input_unit[inport]->increment_credit(invc, true,
-                                m_router->curCycle());
-                        //cout<<"flit id is "<<t_flit->getClkId()<<" inport id is "<<inport
-                        //           <<" invc is "<<t_flit->get_vc()
-                        //           <<" set outport is "<<t_flit->get_outport()<<endl;
-                    }else{
-                        assert(m_input_unit[inport]->get_direction() == "Local");
-                        if ((t_flit->get_type() == TAIL_) ||
-                            t_flit->get_type() == HEAD_TAIL_) {
-                            //TODO:unnecessary to ensure empty
-                            //can process the next one in buffer
-                            // This Input VC should now be empty
-                            //assert(!(m_input_unit[inport]->isReady(invc,
-                            //    m_router->curCycle())));
-
-                            // Free this VC
-                            m_input_unit[inport]->set_vc_idle(invc,
-                                m_router->curCycle());
-
-                            // Send a credit back
-                            // along with the information that this VC is now idle
-                            m_input_unit[inport]->increment_credit(invc, true,
-                                m_router->curCycle());
-                            // if(m_router->get_id()==9){
-                            //     cout<<"SA Free Router "<<m_router->get_id()<<" inport "<< m_input_unit[inport]->get_direction() <<", id is "<<inport<<", invc is "<<invc<<", at cycle "<<m_router->curCycle()<<endl;
-                            // }
-                        } else {
-                            // Send a credit back
-                            // but do not indicate that the VC is idle
-                            m_input_unit[inport]->increment_credit(invc, false,
-                                m_router->curCycle());
-                        }
-                    }
+        // remove flit from Input VC
+        flit *t_flit = m_input_unit[inport]->getTopFlit(invc);
 
-                }else{
-                    if ((t_flit->get_type() == TAIL_) ||
-                        t_flit->get_type() == HEAD_TAIL_) {
-
-                        // This Input VC should now be empty
-                        assert(!(m_input_unit[inport]->isReady(invc,
-                            m_router->curCycle())));
-
-                        // Free this VC
-                        m_input_unit[inport]->set_vc_idle(invc,
-                            m_router->curCycle());
-
-                        // Send a credit back
-                        // along with the information that this VC is now idle
-                        m_input_unit[inport]->increment_credit(invc, true,
-                            m_router->curCycle());
-                    } else {
-                        // Send a credit back
-                        // but do not indicate that the VC is idle
-                        m_input_unit[inport]->increment_credit(invc, false,
-                            m_router->curCycle());
-                    }
-                }
+        if (routing_algo == TDM_ &&
+            !m_routing_unit->is_local_outport(outport)) {
+            m_output_unit[outport]->increment_wave_flits(
+                (int)m_router->getNextWave());
+        }
 
-                //original version
-                /*
+        //make inport as observed
+        inport_observed[inport] = true;
+        //std::cout<<"\nSA select inport "<<inport<<"direction is "<< m_router->router_inport_id2dirn(inport) <<"flit from "<<invc<<endl;
+        //std::cout<<"SA correspoding outport is "<<outport<<endl; 
+        DPRINTF(RubyNetwork, "SwitchAllocator at Router %d "
+                             "granted outvc %d at outport %d "
+                             "to invc %d at inport %d to flit %s at "
+                             "time: %lld\n",
+                m_router->get_id(), outvc,
+                m_router->getPortDirectionName(
+                    m_output_unit[outport]->get_direction()),
+                invc,
+                m_router->getPortDirectionName(
+                    m_input_unit[inport]->get_direction()),
+                    *t_flit,
+                m_router->curCycle());
+
+
+        // Update outport field in the flit since this is
+        // used by CrossbarSwitch code to send it out of
+        // correct outport.
+        // Note: post route compute in InputUnit,
+        // outport is updated in VC, but not in flit
+        t_flit->set_outport(outport);
+
+        // set outvc (i.e., invc for next hop) in flit
+        // (This was updated in VC by vc_allocate, but not in flit)
+        t_flit->set_vc(outvc);
+
+        // decrement credit in outvc
+        m_output_unit[outport]->decrement_credit(outvc);
+        //std::cout<<"SA, at router "<< m_router->get_id() << " selected outport is "<<outport<< "current credit is "<<m_output_unit[outport]->get_credit_count(outvc)<<"out vc is "<<outvc<<endl;
+
+        //check next router id
+
+        // flit ready for Switch Traversal
+        t_flit->advance_stage(ST_, m_router->curCycle());
+        m_router->grant_switch(inport, t_flit);
+        m_output_arbiter_activity++;
+
+        if(routing_algo == DEFLECTION_ || routing_algo == TDM_){
+            //input VC should always be empty, because it only handles 1 flit each time
+            if(!m_routing_unit->is_local_inport(inport)){
+                assert(!(m_input_unit[inport]->isReady(invc,
+                        m_router->curCycle())));
+                m_input_unit[inport]->set_vc_idle(invc,
+                        m_router->curCycle());
+                m_input_unit[inport]->increment_credit(invc, true,
+                        m_router->curCycle());
+                //cout<<"flit id is "<<t_flit->get_packet_id()<<" inport id is "<<inport
+                //           <<" invc is "<<t_flit->get_vc()
+                //           <<" set outport is "<<t_flit->get_outport()<<endl;
+            }else{
+                assert(m_routing_unit->is_local_inport(inport));
                 if ((t_flit->get_type() == TAIL_) ||
                     t_flit->get_type() == HEAD_TAIL_) {
-
+                    //TODO:unnecessary to ensure empty
+                    //can process the next one in buffer
                     // This Input VC should now be empty
-                    assert(!(m_input_unit[inport]->isReady(invc,
-                        m_router->curCycle())));
+                    //assert(!(m_input_unit[inport]->isReady(invc,
+                    //    m_router->curCycle())));
 
                     // Free this VC
                     m_input_unit[inport]->set_vc_idle(invc,
@@ -776,42 +954,100 @@ SwitchAllocator::arbitrate_outports()
                     // along with the information that this VC is now idle
                     m_input_unit[inport]->increment_credit(invc, true,
                         m_router->curCycle());
-                    //std::cout<<"SA, check logic flag here ==================="<<"inport is "<< inport<<endl;
-                    
+                    // if(m_router->get_id()==9){
+                    //     cout<<"SA Free Router "<<m_router->get_id()<<" inport "<< m_input_unit[inport]->get_direction() <<", id is "<<inport<<", invc is "<<invc<<", at cycle "<<m_router->curCycle()<<endl;
+                    // }
                 } else {
                     // Send a credit back
                     // but do not indicate that the VC is idle
-                    if(routing_algo == DEFLECTION_ || routing_algo == TDM_)
-                        panic("current flit type is not a HEAD_TAIL_ flit");
                     m_input_unit[inport]->increment_credit(invc, false,
                         m_router->curCycle());
                 }
-                */
-                //Verify that flits leave the same cycle they arrive
-                if(routing_algo == DEFLECTION_ || routing_algo == TDM_){
-                    //cout<<"SA: "<<"router id "<<m_router->get_id()<<", inport direction "<<m_input_unit[inport]->get_direction()<<", flit time "<<t_flit->get_time()<<", router time "<<m_router->curCycle()<<endl;
-                    assert(t_flit->get_time() == m_router->curCycle() || m_input_unit[inport]->get_direction() == "Local"); 
-                }
-                
+            }
 
-                // remove this request
-                m_port_requests[outport][inport] = false;
+        }else{
+            if ((t_flit->get_type() == TAIL_) ||
+                t_flit->get_type() == HEAD_TAIL_) {
+
+                // This Input VC should now be empty
+                assert(!(m_input_unit[inport]->isReady(invc,
+                    m_router->curCycle())));
+
+                // Free this VC
+                m_input_unit[inport]->set_vc_idle(invc,
+                    m_router->curCycle());
+
+                // Send a credit back
+                // along with the information that this VC is now idle
+                m_input_unit[inport]->increment_credit(invc, true,
+                    m_router->curCycle());
+            } else {
+                // Send a credit back
+                // but do not indicate that the VC is idle
+                m_input_unit[inport]->increment_credit(invc, false,
+                    m_router->curCycle());
+            }
+        }
 
-                // Update Round Robin pointer
-                m_round_robin_inport[outport] = inport + 1;
-                if (m_round_robin_inport[outport] >= m_num_inports)
-                    m_round_robin_inport[outport] = 0;
+        //original version
+        /*
+        if ((t_flit->get_type() == TAIL_) ||
+            t_flit->get_type() == HEAD_TAIL_) {
 
-                break; // got a input winner for this outport
-            }
+            // This Input VC should now be empty
+            assert(!(m_input_unit[inport]->isReady(invc,
+                m_router->curCycle())));
+
+            // Free this VC
+            m_input_unit[inport]->set_vc_idle(invc,
+                m_router->curCycle());
 
-            inport++;
-            if (inport >= m_num_inports)
-                inport = 0;
+            // Send a credit back
+            // along with the information that this VC is now idle
+            m_input_unit[inport]->increment_credit(invc, true,
+                m_router->curCycle());
+            //std::cout<<"SA, check logic flag here ==================="<<"inport is "<< inport<<endl;
+            
+        } else {
+            // Send a credit back
+            // but do not indicate that the VC is idle
+            if(routing_algo == DEFLECTION_ || routing_algo == TDM_)
+                panic("current flit type is not a HEAD_TAIL_ flit");
+            m_input_unit[inport]->increment_credit(invc, false,
+                m_router->curCycle());
         }
+        */
+        //Verify that flits leave the same cycle they arrive
+        if(routing_algo == DEFLECTION_ || routing_algo == TDM_){
+            //cout<<"SA: "<<"router id "<<m_router->get_id()<<", inport direction "<<m_input_unit[inport]->get_direction()<<", flit time "<<t_flit->get_time()<<", router time "<<m_router->curCycle()<<endl;
+            assert(t_flit->get_time() == m_router->curCycle() || m_routing_unit->is_local_inport(inport)); 
+        }
+        
+
+        // remove this request
+        m_port_requests[outport] &= ~((uint64_t)1 << inport);
+
+        // Update Round Robin pointer
+        m_round_robin_inport[outport] = inport + 1;
+        if (m_round_robin_inport[outport] >= m_num_inports)
+            m_round_robin_inport[outport] = 0;
     }
 }
 
+// First inport with a request at or after inport start, wrapping around.
+int
+SwitchAllocator::roundRobinPick(uint64_t requests, int start)
+{
+    assert(requests != 0 && start < m_num_inports);
+    uint64_t rotated = requests >> start;
+    if (start > 0)
+        rotated |= requests << (m_num_inports - start);
+    int inport = start + findLsbSet(rotated);
+    if (inport >= m_num_inports)
+        inport -= m_num_inports;
+    return inport;
+}
+
 /*
  * A flit can be sent only if
  * (1) there is at least one free output VC at the
@@ -945,14 +1181,15 @@ SwitchAllocator::check_for_wakeup()
 {
     Cycles nextCycle = m_router->curCycle() + Cycles(1);
 
-    for (int i = 0; i < m_num_inports; i++) {
-        for (int j = 0; j < m_num_vcs; j++) {
-            if (m_input_unit[i]->need_stage(j, SA_, nextCycle)) {
-                m_router->schedule_wakeup(Cycles(1));
-                return;
-            }
-        }
+    // side buffer flits are retried every cycle
+    if (!m_side_buffer.isEmpty()) {
+        m_router->schedule_wakeup(Cycles(1));
+        return;
     }
+
+    // some buffered flit can go for SA by next cycle
+    if (m_router->sa_ready_by(nextCycle))
+        m_router->schedule_wakeup(Cycles(1));
 }
 
 int
@@ -969,11 +1206,7 @@ SwitchAllocator::get_vnet(int invc)
 void
 SwitchAllocator::clear_request_vector()
 {
-    for (int i = 0; i < m_num_outports; i++) {
-        for (int j = 0; j < m_num_inports; j++) {
-            m_port_requests[i][j] = false;
-        }
-    }
+    memset(m_port_requests.data(), 0, m_num_outports * sizeof(uint64_t));
 }
 
 void
@@ -993,7 +1226,7 @@ SwitchAllocator::verify_VCs_empty(){
         //A + A'B = A + B;
         //Idle || Idle'.Local = Idle || Local;
         //the index of vc of each vnet is vnet its self, if the num-vc-per-vnet == 1
-        assert(m_input_unit[inport]->is_invc0_idle() || (m_input_unit[inport]->get_direction() == "Local"));
+        assert(m_input_unit[inport]->is_invc0_idle() || (m_routing_unit->is_local_inport(inport)));
     }
 
 }
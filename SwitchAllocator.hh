@@ -50,6 +50,7 @@ using namespace std;
 class Router;
 class InputUnit;
 class OutputUnit;
+class RoutingUnit;
 
 class SwitchAllocator : public Consumer
 {
@@ -69,9 +70,12 @@ class SwitchAllocator : public Consumer
     //added for deflection
     void permutation_CHIPPER();
     void permutation_BLESS();
+    void permutation_network();
 
     void verify_VCs_empty();
 
+    uint32_t functionalWrite(Packet *pkt);
+
     inline double
     get_input_arbiter_activity()
     {
@@ -92,26 +96,68 @@ class SwitchAllocator : public Consumer
     double m_input_arbiter_activity, m_output_arbiter_activity;
 
     Router *m_router;
+    RoutingUnit *m_routing_unit;
     std::vector<int> m_round_robin_invc;
     std::vector<int> m_round_robin_inport;
-    std::vector<std::vector<bool>> m_port_requests;
+    // bit i of m_port_requests[outport] is set if inport i requests it
+    std::vector<uint64_t> m_port_requests;
+    uint64_t m_local_inport_mask;
     std::vector<std::vector<int>> m_vc_winners; // a list for each outport
     std::vector<InputUnit *> m_input_unit;
     std::vector<OutputUnit *> m_output_unit;
 
     //added for tdm
     //std::vector<vector<int>> m_wave_table;
-    std::vector<int>num_ports_req;
-    std::vector<int>num_local_req;
-    std::vector<bool> outport_ava;
+    // bit p is set while outport p is still free this cycle
+    uint64_t m_outport_ava;
+    uint64_t m_all_outport_mask;
+    uint64_t m_nonlocal_outport_mask;
+    // per inport, the outports in the direction it came from (U-turns)
+    std::vector<uint64_t> m_uturn_outport_mask;
 
     //added for deflection
     std::vector<pair<flit*, int>> m_permu_buf;
     std::vector<bool> inport_observed;
-    bool compareFlitID(pair<flit*, int> a, pair<flit*, int> b);
-    int getANonLocalOutport(PortDirection in_dirn);
+    static bool compareFlitID(const pair<flit*, int> &a,
+                              const pair<flit*, int> &b);
+    static bool compareFlitAge(const pair<flit*, int> &a,
+                               const pair<flit*, int> &b);
+    static void sortFlits(pair<flit*, int> *flits, int num_flits,
+                          bool (*less)(const pair<flit*, int> &,
+                                       const pair<flit*, int> &));
+    int getANonLocalOutport(int inport);
+    void placeNonLocalFlit(int inport, int invc, bool may_absorb);
+
+    // CHIPPER permutation network, used when the router has exactly
+    // PERMUTATION_SLOTS_ non-local inports and outports (else CHIPPER):
+    // non-local inport/outport -> slot, and slot -> outport
+    bool m_pn_enabled;
+    std::vector<int> m_pn_inport_slot;
+    std::vector<int> m_pn_outport_slot;
+    int m_pn_slot_outport[PERMUTATION_SLOTS_];
+    // flits inside the network this cycle
+    flit *m_pn_flit[PERMUTATION_SLOTS_];
+    int m_pn_inport[PERMUTATION_SLOTS_];
+    int m_pn_want[PERMUTATION_SLOTS_];  // wanted output slot, -1: any
+    bool pnHigherPriority(int a, int b);
+    void pnArbiterBlock(int stage, int block, const int in[2], int out[2]);
+    void placeLocalFlit(int inport, int invc);
+    int roundRobinPick(uint64_t requests, int start);
+
+    // MinBD side buffer (deflection routing, side_buffer_depth > 0).
+    // Takes at most one flit per cycle that would otherwise be deflected,
+    // and sends the oldest buffered flit out through an idle crossbar
+    // input once its preferred outport is free.
+    flitBuffer m_side_buffer;
+    int m_side_buffer_depth;
+    bool m_side_absorbed;               // a flit was taken this cycle
+    uint64_t m_side_absorbed_inports;   // the inport it came from
+    int m_side_outport;                 // outport reserved this cycle
+    bool absorbSideFlit(int inport, int invc);
+    void reinjectSideFlit();
 
     void areLinksAvaliable();
+    void countWaveBlocked();
 
 
 };
@@ -77,25 +77,11 @@ flit::flit(int id, int  vc, int vnet, RouteInfo route, int size,
     m_stage.second = m_time;
     m_marked = marked;
 
-    //added for deflection
-    //NoC saturate at 100 cycles
-    //pick 10000 as threashold for flit id update
-    //no duplicate id will appear 
-    int offset = (int) curTime % Cycles(FLIT_ID_);
-    int index = route.src_ni * FLIT_ID_;
-    m_clk_id = index + offset;
-    
-    //set up pusedo gold state threashold for each flit
-    //the reason to add id is because it count the # of cycle in NoC
-    //not the hop count, in our case, every trans stage is 2 cycle, so id should be divided by 2
-    //assume 4x4 mesh
-    int src_row = m_route.src_router / 4;
-    int dst_row = m_route.dest_router / 4;
-    int src_col = m_route.src_router % 4;
-    int dst_col = m_route.dest_router % 4;
-    
-    m_gold_th = abs(dst_row - src_row) + abs(dst_col - src_col);
+    //gold state threshold, set by the NI from the network's gold policy
+    m_gold_th = INFINITE_;
     is_gold = false;
+    m_gold_time = Cycles(MaxTick);
+    m_packet_seq = 0;
     //m_type = HEAD_TAIL_;
     
     if (size == 1) {
@@ -118,7 +104,7 @@ flit::print(std::ostream& out) const
 {
     out << "[flit:: ";
     out << "Id=" << m_id << " ";
-    out << "Id=" << m_clk_id << " ";
+    out << "PacketId=" << get_packet_id() << " ";
     out << "size=" << m_size << " ";
     out << "Type=" << m_type << " ";
     out << "Vnet=" << m_vnet << " ";
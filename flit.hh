@@ -75,10 +75,31 @@ class flit
     void print(std::ostream& out) const;
 
     //new added for CHIPPER deflection 
-    void set_gold_state() {is_gold = true;}
+    void
+    set_gold_state(Cycles time)
+    {
+        if (!was_gold())
+            m_gold_time = time;
+        is_gold = true;
+    }
+    void clear_gold_state() {is_gold = false;}
     bool is_gold_state() {return is_gold;}
+    bool was_gold() {return m_gold_time != Cycles(MaxTick);}
+    Cycles get_gold_time() {return m_gold_time;}
     int get_gold_th() {return m_gold_th;}
+    void set_gold_th(int gold_th) {m_gold_th = gold_th;}
     int get_hop_count() {return m_route.hops_traversed;}
+    int get_src_ni() {return m_route.src_ni;}
+    int get_dest_ni() {return m_route.dest_ni;}
+    // sequence number of the packet at its source NI
+    uint32_t get_packet_seq() {return m_packet_seq;}
+    void set_packet_seq(uint32_t seq) {m_packet_seq = seq;}
+    // network-wide unique packet id: source NI and its sequence number
+    uint64_t
+    get_packet_id() const
+    {
+        return ((uint64_t)m_route.src_ni << 32) | m_packet_seq;
+    }
 
     bool
     is_stage(flit_stage stage, Cycles time)
@@ -108,8 +129,6 @@ class flit
     bool functionalWrite(Packet *pkt);
     bool m_marked;
 
-    //new added for deflection
-    int getClkId() {return m_clk_id; }
   protected:
     int m_id;
     int m_vnet;
@@ -124,9 +143,10 @@ class flit
     std::pair<flit_stage, Cycles> m_stage;
 
     //new added for deflection
-    int m_clk_id;
     int m_gold_th;
     bool is_gold;
+    Cycles m_gold_time;
+    uint32_t m_packet_seq;
 };
 
 inline std::ostream&
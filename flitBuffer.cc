@@ -33,26 +33,53 @@
 
 #include "mem/ruby/network/garnet2.0/flitBuffer.hh"
 
+// initial ring size, doubled whenever a ring buffer fills up
+#define RING_BUFFER_SIZE_ 8
+
 flitBuffer::flitBuffer()
+    : m_type(HEAP_BUFFER_), m_size(0), m_head(0), m_mask(0)
 {
     max_size = INFINITE_;
 }
 
 flitBuffer::flitBuffer(int maximum_size)
+    : m_type(HEAP_BUFFER_), m_size(0), m_head(0), m_mask(0)
 {
     max_size = maximum_size;
 }
 
+flitBuffer::flitBuffer(flitBuffer_type type)
+    : m_type(type), m_size(0), m_head(0), m_mask(0)
+{
+    max_size = INFINITE_;
+    if (m_type == RING_BUFFER_) {
+        m_buffer.resize(RING_BUFFER_SIZE_, nullptr);
+        m_mask = RING_BUFFER_SIZE_ - 1;
+    }
+}
+
+void
+flitBuffer::grow()
+{
+    assert(m_type == RING_BUFFER_ && m_size == m_buffer.size());
+    std::vector<flit *> ring(2 * m_buffer.size(), nullptr);
+    for (int i = 0; i < m_size; i++)
+        ring[i] = m_buffer[(m_head + i) & m_mask];
+    m_buffer.swap(ring);
+    m_head = 0;
+    m_mask = m_buffer.size() - 1;
+}
+
 bool
 flitBuffer::isEmpty()
 {
-    return (m_buffer.size() == 0);
+    return (m_size == 0);
 }
 
 bool
 flitBuffer::isReady(Cycles curTime)
 {
-    if (m_buffer.size() != 0 ) {
+    if (m_size != 0 ) {
         flit *t_flit = peekTopFlit();
         if (t_flit->get_time() <= curTime)
             return true;
@@ -63,13 +90,13 @@ flitBuffer::isReady(Cycles curTime)
 void
 flitBuffer::print(std::ostream& out) const
 {
-    out << "[flitBuffer: " << m_buffer.size() << "] " << std::endl;
+    out << "[flitBuffer: " << m_size << "] " << std::endl;
 }
 
 bool
 flitBuffer::isFull()
 {
-    return (m_buffer.size() >= max_size);
+    return (m_size >= max_size);
 }
 
 void
@@ -83,8 +110,9 @@ flitBuffer::functionalWrite(Packet *pkt)
 {
     uint32_t num_functional_writes = 0;
 
-    for (unsigned int i = 0; i < m_buffer.size(); ++i) {
-        if (m_buffer[i]->functionalWrite(pkt)) {
+    for (int i = 0; i < m_size; ++i) {
+        int idx = (m_type == RING_BUFFER_) ? ((m_head + i) & m_mask) : i;
+        if (m_buffer[idx]->functionalWrite(pkt)) {
             num_functional_writes++;
         }
     }
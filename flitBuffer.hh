@@ -35,6 +35,7 @@
 #define __MEM_RUBY_NETWORK_GARNET2_0_FLITBUFFER_HH__
 
 #include <algorithm>
+#include <cassert>
 #include <iostream>
 #include <vector>
 
@@ -46,27 +47,40 @@ class flitBuffer
   public:
     flitBuffer();
     flitBuffer(int maximum_size);
+    // RING_BUFFER_ is for buffers whose flits always arrive in time order
+    // (links, credit queues, NI queues, crossbar and output buffers)
+    flitBuffer(flitBuffer_type type);
 
     bool isReady(Cycles curTime);
     bool isEmpty();
     void print(std::ostream& out) const;
     bool isFull();
     void setMaxSize(int maximum);
-    int getSize() const { return m_buffer.size(); }
+    int getSize() const { return m_size; }
         //modify for deflection
     flit *
     getTopFlit()
     {
-        flit *f = m_buffer.front();
-        //flit *f = m_buffer.back();
-        std::pop_heap(m_buffer.begin(), m_buffer.end(), flit::greater);
-        m_buffer.pop_back();
+        assert(m_size > 0);
+        flit *f;
+        if (m_type == RING_BUFFER_) {
+            f = m_buffer[m_head];
+            m_head = (m_head + 1) & m_mask;
+        } else {
+            f = m_buffer.front();
+            //flit *f = m_buffer.back();
+            std::pop_heap(m_buffer.begin(), m_buffer.end(), flit::greater);
+            m_buffer.pop_back();
+        }
+        m_size--;
         return f;
     }
 
     flit *
     peekTopFlit()
-    {      
+    {
+        if (m_type == RING_BUFFER_)
+            return m_buffer[m_head];
         return m_buffer.front();
         //return m_buffer.back();
     }
@@ -74,14 +88,32 @@ class flitBuffer
     void
     insert(flit *flt)
     {
-        m_buffer.push_back(flt);
-        std::push_heap(m_buffer.begin(), m_buffer.end(), flit::greater);
+        if (m_type == RING_BUFFER_) {
+            if (m_size == m_buffer.size())
+                grow();
+            // a ring buffer cannot reorder flits
+            assert(m_size == 0 || flt->get_time() >=
+                   m_buffer[(m_head + m_size - 1) & m_mask]->get_time());
+            m_buffer[(m_head + m_size) & m_mask] = flt;
+        } else {
+            m_buffer.push_back(flt);
+            std::push_heap(m_buffer.begin(), m_buffer.end(), flit::greater);
+        }
+        m_size++;
     }
 
     uint32_t functionalWrite(Packet *pkt);
 
   private:
+    void grow();
+
+    flitBuffer_type m_type;
+    // heap, or ring storage of a power of two size
     std::vector<flit *> m_buffer;
+    int m_size;
+    // ring buffer only: index of the oldest flit, and size - 1
+    int m_head;
+    int m_mask;
     int max_size;
 };
 
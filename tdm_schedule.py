@@ -0,0 +1,402 @@
+# Copyright (c) 2019 Georgia Institute of Technology
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met: redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer;
+# redistributions in binary form must reproduce the above copyright
+# notice, this list of conditions and the following disclaimer in the
+# documentation and/or other materials provided with the distribution;
+# neither the name of the copyright holders nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+# Authors: Chen Chen
+#
+
+# Offline TDM wave schedule compiler and validator.
+#
+# Routes are the ones the routing table would pick: a link is a candidate
+# towards a destination if it lies on a minimum weight path (Topology),
+# and among those only the minimum weight links are kept
+# (RoutingUnit::lookupRoutingTable / outportComputeTDM).
+#
+# Timing model: a flit that leaves a router on a link in wave w leaves
+# the next router in wave (w + hop_waves) % num_waves. A path is wave
+# consistent if every link on it is open in the wave it is used in.
+# Local (NI) links are always open. In the simulator switch allocation
+# at cycle t checks wave t + 1 (Router::getNextWave), the crossbar runs
+# in the same cycle, the link wakes up at t + 1 and delivers to the next
+# router at t + 1 + link latency, whose switch allocation runs pipe_stages
+# - 1 cycles later, so hop_waves = link latency + router latency (the
+# NI injection wave, NetworkInterface::getInjectionWave, adds the same).
+#
+# The compiler gives every source/destination pair an injection wave and
+# a path, preferring (link, wave) slots no other pair uses yet, and opens
+# each link in the waves of the slots assigned to it.
+#
+# Usage:
+#   tdm_schedule.py --rows 8 --cols 8 --waves 16 --router-latency 1 \
+#       --link-latency 1 [--output sched.json]
+#   tdm_schedule.py --rows 8 --cols 8 --waves 16 --router-latency 1 \
+#       --link-latency 1 --check sched.json
+#
+# From a topology file:
+#   from tdm_schedule import MeshTopology, compile_schedule, hop_waves
+#   sched = compile_schedule(MeshTopology(rows, cols), num_waves,
+#                            hop_waves(router_latency, link_latency))
+#   IntLink(..., wave=sched.waves[(src, dst)])
+
+from __future__ import print_function
+
+import argparse
+import json
+import sys
+
+# Must match MAX_WAVES_ in CommonTypes.hh
+MAX_WAVES = 64
+# Upper bound on candidate paths explored per pair
+MAX_PATHS = 16
+
+
+class MeshTopology(object):
+    """Routers and unidirectional links of a Mesh_XY style mesh.
+
+    With the Mesh_XY weights (x links 1, y links 2) the table routes
+    are XY routes.
+    """
+    def __init__(self, rows, cols, x_weight=1, y_weight=2):
+        assert rows > 0 and cols > 0
+        self.rows = rows
+        self.cols = cols
+        self.num_routers = rows * cols
+        # (src, dst) -> (weight, src_outport)
+        self.links = {}
+        for row in range(rows):
+            for col in range(cols):
+                r = col + row * cols
+                if col + 1 < cols:
+                    self.links[(r, r + 1)] = (x_weight, "East")
+                    self.links[(r + 1, r)] = (x_weight, "West")
+                if row + 1 < rows:
+                    self.links[(r, r + cols)] = (y_weight, "North")
+                    self.links[(r + cols, r)] = (y_weight, "South")
+        self.out_links = [[] for _ in range(self.num_routers)]
+        for (src, dst) in sorted(self.links):
+            self.out_links[src].append(dst)
+
+
+def shortest_distances(topo):
+    """All-pairs minimum weight distances (Floyd-Warshall)."""
+    n = topo.num_routers
+    inf = float("inf")
+    dist = [[inf] * n for _ in range(n)]
+    for i in range(n):
+        dist[i][i] = 0
+    for (src, dst), (weight, _) in topo.links.items():
+        dist[src][dst] = min(dist[src][dst], weight)
+    for k in range(n):
+        dk = dist[k]
+        for i in range(n):
+            di = dist[i]
+            dik = di[k]
+            if dik == inf:
+                continue
+            for j in range(n):
+                if dik + dk[j] < di[j]:
+                    di[j] = dik + dk[j]
+    return dist
+
+
+def route_candidates(topo, dist):
+    """cand[u][d]: next routers the routing table may pick at u for d."""
+    n = topo.num_routers
+    cand = [[[] for _ in range(n)] for _ in range(n)]
+    for u in range(n):
+        for d in range(n):
+            if u == d:
+                continue
+            on_path = [v for v in topo.out_links[u]
+                       if topo.links[(u, v)][0] + dist[v][d] == dist[u][d]]
+            if not on_path:
+                continue
+            min_weight = min(topo.links[(u, v)][0] for v in on_path)
+            cand[u][d] = [v for v in on_path
+                          if topo.links[(u, v)][0] == min_weight]
+    return cand
+
+
+def candidate_paths(cand, src, dst):
+    """Router paths from src to dst following candidate links."""
+    paths = []
+    stack = [[src]]
+    while stack and len(paths) < MAX_PATHS:
+        path = stack.pop()
+        u = path[-1]
+        if u == dst:
+            paths.append(path)
+            continue
+        for v in reversed(cand[u][dst]):
+            stack.append(path + [v])
+    return paths
+
+
+def hop_waves(router_latency, link_latency):
+    """Waves between the departures of a flit from two adjacent routers."""
+    if router_latency < 1 or link_latency < 1:
+        raise ValueError("router and link latency must be at least 1")
+    return link_latency + router_latency
+
+
+def rotr(mask, shift, num_waves):
+    """Bit w of the result is bit (w + shift) % num_waves of mask."""
+    full = (1 << num_waves) - 1
+    shift %= num_waves
+    return ((mask >> shift) | (mask << (num_waves - shift))) & full
+
+
+def max_wait(mask, num_waves):
+    """Worst-case number of waves until a set bit, over all start waves."""
+    if mask == 0:
+        return None
+    bits = [w for w in range(num_waves) if (mask >> w) & 1]
+    worst = 0
+    for i, w in enumerate(bits):
+        nxt = bits[(i + 1) % len(bits)]
+        gap = (nxt - w - 1) % num_waves
+        worst = max(worst, gap)
+    return worst
+
+
+class Schedule(object):
+    def __init__(self, topo, num_waves, hop_waves):
+        self.topo = topo
+        self.num_waves = num_waves
+        self.hop_waves = hop_waves
+        # (src, dst) router link -> sorted list of open waves
+        self.waves = {}
+        # (src, dst) pair -> (injection wave, router path)
+        self.assignment = {}
+        # pairs whose assigned slots are shared with another pair
+        self.contended = []
+
+
+def compile_schedule(topo, num_waves, hop_waves):
+    """Assign an injection wave and path to every router pair."""
+    if num_waves < 1 or num_waves > MAX_WAVES:
+        raise ValueError("num_waves must be in [1, %d]" % MAX_WAVES)
+
+    dist = shortest_distances(topo)
+    cand = route_candidates(topo, dist)
+    sched = Schedule(topo, num_waves, hop_waves)
+
+    # (link, wave) -> number of pairs using that slot
+    owners = {}
+    pairs = [(s, d) for s in range(topo.num_routers)
+             for d in range(topo.num_routers) if s != d]
+    # Longest routes are the hardest to fit, place them first
+    pairs.sort(key=lambda p: (-dist[p[0]][p[1]], p))
+
+    for (src, dst) in pairs:
+        paths = candidate_paths(cand, src, dst)
+        if not paths:
+            raise ValueError("no route from router %d to router %d"
+                             % (src, dst))
+        best = None
+        for path in paths:
+            for offset in range(num_waves):
+                # spread the injection waves of different sources
+                w0 = (offset + src) % num_waves
+                cost = 0
+                for hop in range(len(path) - 1):
+                    slot = ((path[hop], path[hop + 1]),
+                            (w0 + hop * hop_waves) % num_waves)
+                    if owners.get(slot, 0) > 0:
+                        cost += 1
+                if best is None or cost < best[0]:
+                    best = (cost, w0, path)
+                if cost == 0:
+                    break
+            if best[0] == 0:
+                break
+
+        cost, w0, path = best
+        for hop in range(len(path) - 1):
+            slot = ((path[hop], path[hop + 1]),
+                    (w0 + hop * hop_waves) % num_waves)
+            owners[slot] = owners.get(slot, 0) + 1
+        sched.assignment[(src, dst)] = (w0, path)
+
+    for link in topo.links:
+        sched.waves[link] = []
+    for (link, wave) in sorted(owners):
+        sched.waves[link].append(wave)
+
+    for pair, (w0, path) in sorted(sched.assignment.items()):
+        for hop in range(len(path) - 1):
+            slot = ((path[hop], path[hop + 1]),
+                    (w0 + hop * hop_waves) % num_waves)
+            if owners[slot] > 1:
+                sched.contended.append(pair)
+                break
+    return sched
+
+
+def validate_schedule(topo, waves, num_waves, hop_waves):
+    """Check that every pair has a wave consistent table route.
+
+    Returns (errors, wait) where wait[(src, dst)] is the worst-case number
+    of waves a flit at src waits before it can depart on such a route.
+    """
+    errors = []
+    for link, link_waves in sorted(waves.items()):
+        if link not in topo.links:
+            errors.append("link %d->%d is not in the topology" % link)
+            continue
+        for w in link_waves:
+            if w < 0 or w >= num_waves:
+                errors.append("link %d->%d: wave %d outside [0, %d)"
+                              % (link[0], link[1], w, num_waves))
+    for link in sorted(topo.links):
+        if not waves.get(link):
+            errors.append("link %d->%d has no wave" % link)
+
+    open_mask = {}
+    for link in topo.links:
+        mask = 0
+        for w in waves.get(link, []):
+            if 0 <= w < num_waves:
+                mask |= 1 << w
+        open_mask[link] = mask
+
+    dist = shortest_distances(topo)
+    cand = route_candidates(topo, dist)
+    full = (1 << num_waves) - 1
+    wait = {}
+    for dst in range(topo.num_routers):
+        # reach[u]: bit w set if a flit at u departing in wave w
+        # can reach dst on a wave consistent table route
+        reach = [0] * topo.num_routers
+        reach[dst] = full
+        order = sorted(range(topo.num_routers), key=lambda u: dist[u][dst])
+        for u in order:
+            if u == dst:
+                continue
+            mask = 0
+            for v in cand[u][dst]:
+                mask |= open_mask[(u, v)] & \
+                    rotr(reach[v], hop_waves, num_waves)
+            reach[u] = mask
+        for src in range(topo.num_routers):
+            if src == dst:
+                continue
+            wait[(src, dst)] = max_wait(reach[src], num_waves)
+            if wait[(src, dst)] is None:
+                errors.append("no wave consistent route from router %d "
+                              "to router %d" % (src, dst))
+    return errors, wait
+
+
+def waves_to_json(sched):
+    return {"num_waves": sched.num_waves,
+            "hop_waves": sched.hop_waves,
+            "links": [{"src": src, "dst": dst,
+                       "src_outport": sched.topo.links[(src, dst)][1],
+                       "wave": sched.waves[(src, dst)]}
+                      for (src, dst) in sorted(sched.waves)]}
+
+
+def waves_from_json(data):
+    return dict(((l["src"], l["dst"]), list(l["wave"]))
+                for l in data["links"])
+
+
+def report(topo, waves, num_waves, hop_waves, out, per_pair):
+    errors, wait = validate_schedule(topo, waves, num_waves, hop_waves)
+    for err in errors:
+        print("error: " + err, file=out)
+    waits = [w for w in wait.values() if w is not None]
+    if waits:
+        print("pairs: %d, unroutable: %d, worst wave wait: %d, "
+              "average worst wave wait: %.2f"
+              % (len(wait), len(wait) - len(waits), max(waits),
+                 float(sum(waits)) / len(waits)), file=out)
+    if per_pair:
+        for (src, dst) in sorted(wait):
+            w = wait[(src, dst)]
+            print("%d -> %d: %s" % (src, dst, "-" if w is None else w),
+                  file=out)
+    return len(errors) == 0
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Compile or check a TDM wave schedule for a mesh")
+    parser.add_argument("--rows", type=int, required=True)
+    parser.add_argument("--cols", type=int, required=True)
+    parser.add_argument("--waves", type=int, required=True,
+                        help="number of waves (wave number in clock_object)")
+    parser.add_argument("--router-latency", type=int, default=1,
+                        help="router pipeline stages (GarnetRouter latency)")
+    parser.add_argument("--link-latency", type=int, default=1,
+                        help="internal link latency in cycles")
+    parser.add_argument("--hop-waves", type=int,
+                        help="waves elapsed between the departures of a "
+                        "flit from two consecutive routers, default: "
+                        "router latency + link latency")
+    parser.add_argument("--x-weight", type=int, default=1)
+    parser.add_argument("--y-weight", type=int, default=2)
+    parser.add_argument("--check", metavar="FILE",
+                        help="validate a schedule instead of compiling one")
+    parser.add_argument("--output", metavar="FILE",
+                        help="write the compiled schedule as json")
+    parser.add_argument("--per-pair", action="store_true",
+                        help="report the worst wave wait of every pair")
+    args = parser.parse_args()
+
+    topo = MeshTopology(args.rows, args.cols, args.x_weight, args.y_weight)
+    shift = args.hop_waves
+    if shift is None:
+        shift = hop_waves(args.router_latency, args.link_latency)
+
+    if args.check:
+        with open(args.check) as f:
+            data = json.load(f)
+        if data.get("hop_waves", shift) != shift:
+            print("error: schedule compiled for %d waves per hop, "
+                  "checking with %d" % (data["hop_waves"], shift))
+            return 1
+        ok = report(topo, waves_from_json(data), args.waves,
+                    shift, sys.stdout, args.per_pair)
+        return 0 if ok else 1
+
+    sched = compile_schedule(topo, args.waves, shift)
+    print("contended pairs: %d of %d"
+          % (len(sched.contended), len(sched.assignment)))
+    ok = report(topo, sched.waves, args.waves, shift,
+                sys.stdout, args.per_pair)
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(waves_to_json(sched), f, indent=1)
+    else:
+        for (src, dst) in sorted(sched.waves):
+            print("%d -> %d %s: %s" % (src, dst, topo.links[(src, dst)][1],
+                                       sched.waves[(src, dst)]))
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())